@@ -0,0 +1,102 @@
+#include "arena.h"
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+
+using namespace std;
+
+Arena::Arena(size_t block_size)
+	: m_current(0), m_block_size(block_size), m_bytes_in_use(0)
+{
+}
+
+Arena::~Arena()
+{
+	release();
+}
+
+/** @brief Arena::allocate - Hand out some memory from the arena
+ *
+ * @param size_t size - how many bytes are needed
+ * @return void* - memory aligned to ALIGNMENT, which stays valid until the
+ *                 arena is reset or released
+ *
+ **/
+void* Arena::allocate(size_t size)
+{
+	// keep every allocation a whole number of cache lines, so the next one
+	// stays aligned
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	if(size == 0)
+		size = ALIGNMENT;
+
+	// find a block with room, starting from the current one
+	while(m_current < m_blocks.size() && m_blocks[m_current].used + size > m_blocks[m_current].size)
+		m_current++;
+
+	if(m_current == m_blocks.size())
+	{
+		// each new block is at least twice the size of the last, so a growing
+		// arena only needs a few of them
+		size_t block_size = m_block_size;
+		if(!m_blocks.empty())
+			block_size = max(block_size, m_blocks.back().size * 2);
+		block_size = max(block_size, size);
+
+		Block block;
+		block.memory = static_cast<char*>(malloc(block_size + ALIGNMENT - 1));
+		if(!block.memory)
+			throw bad_alloc();
+		size_t address = reinterpret_cast<size_t>(block.memory);
+		block.start = block.memory + ((ALIGNMENT - address % ALIGNMENT) % ALIGNMENT);
+		block.size = block_size;
+		block.used = 0;
+		m_blocks.push_back(block);
+	}
+
+	Block& block = m_blocks[m_current];
+	void* memory = block.start + block.used;
+	block.used += size;
+	m_bytes_in_use += size;
+	return memory;
+}
+
+/** @brief Arena::reset - Give back everything allocated from the arena at once
+ *
+ * The blocks are kept, so the arena can hand the same memory out again without
+ * going back to the heap.
+ *
+ **/
+void Arena::reset()
+{
+	for(size_t b = 0; b <= m_current && b < m_blocks.size(); b++)
+		m_blocks[b].used = 0;
+	m_current = 0;
+	m_bytes_in_use = 0;
+}
+
+/** @brief Arena::release - Give back everything allocated from the arena, and return
+ *                          its blocks to the heap
+ *
+ **/
+void Arena::release()
+{
+	for(size_t b = 0; b < m_blocks.size(); b++)
+		free(m_blocks[b].memory);
+	m_blocks.clear();
+	m_current = 0;
+	m_bytes_in_use = 0;
+}
+
+/** @brief Arena::getBytesReserved - Count the memory the arena holds
+ *
+ * @return size_t - the bytes in all the arena's blocks, in use or not
+ *
+ **/
+size_t Arena::getBytesReserved() const
+{
+	size_t total = 0;
+	for(size_t b = 0; b < m_blocks.size(); b++)
+		total += m_blocks[b].size;
+	return total;
+}
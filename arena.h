@@ -0,0 +1,129 @@
+// arena.h
+
+// A simple arena (bump) allocator. Memory is handed out from large blocks
+// by moving a pointer along, and is never freed piece by piece: reset()
+// gives everything back at once, and the blocks are kept to be handed out
+// again. The simulation's storage comes from arenas, so a reset doesn't
+// free thousands of separate allocations, and long sessions with many
+// resets don't fragment the heap.
+//
+// Only plain data (numbers, structs of numbers) should live in an arena,
+// since nothing allocated from it is ever destroyed.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+class Arena
+{
+public:
+	explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE);
+	~Arena();
+
+	void* allocate(size_t size);
+	template<class T>
+	T* allocateArray(size_t count) {return static_cast<T*>(allocate(count * sizeof(T)));}
+
+	void reset();
+	void release();
+
+	// how much of the arena has been handed out since the last reset
+	size_t getBytesInUse() const {return m_bytes_in_use;}
+	// how much memory the arena holds, in use or not
+	size_t getBytesReserved() const;
+
+	// every allocation starts on a cache line
+	static const size_t ALIGNMENT = 64;
+	static const size_t DEFAULT_BLOCK_SIZE = 1 << 16;
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	struct Block
+	{
+		char* memory;   // as it came from malloc
+		char* start;    // the first aligned byte
+		size_t size;    // usable bytes from start
+		size_t used;
+	};
+
+	std::vector<Block> m_blocks;
+	// the block allocations are being made from; the ones before it are full
+	size_t m_current;
+	size_t m_block_size;
+	size_t m_bytes_in_use;
+};
+
+// A growable array of plain data kept in an arena, for the flock's
+// component arrays. It works like a std::vector, except that when it
+// grows the old memory just stays in the arena until the arena is reset,
+// and copying one copies the elements into its own memory.
+template<class T>
+class ArenaArray
+{
+public:
+	ArenaArray() : m_arena(NULL), m_data(NULL), m_size(0), m_capacity(0) {}
+
+	// arrays start with no arena, and have to be given one before they grow
+	void setArena(Arena* arena) {m_arena = arena; detach();}
+
+	ArenaArray& operator=(const ArenaArray& other)
+	{
+		if(this != &other)
+		{
+			reserve(other.m_size);
+			for(size_t i = 0; i < other.m_size; i++)
+				m_data[i] = other.m_data[i];
+			m_size = other.m_size;
+		}
+		return *this;
+	}
+
+	size_t size() const {return m_size;}
+	bool empty() const {return m_size == 0;}
+	T& operator[](size_t i) {return m_data[i];}
+	const T& operator[](size_t i) const {return m_data[i];}
+	T* data() {return m_data;}
+	const T* data() const {return m_data;}
+
+	void push_back(const T& value)
+	{
+		if(m_size == m_capacity)
+			reserve(m_size + 1);
+		m_data[m_size++] = value;
+	}
+	void pop_back() {m_size--;}
+	// new elements are left as they were
+	void resize(size_t size) {reserve(size); m_size = size;}
+	void clear() {m_size = 0;}
+
+	void reserve(size_t capacity)
+	{
+		if(capacity <= m_capacity)
+			return;
+		// at least double, so growing one at a time only copies a few times
+		capacity = (capacity < 2 * m_capacity) ? 2 * m_capacity : capacity;
+		capacity = (capacity < 16) ? 16 : capacity;
+		T* data = m_arena->allocateArray<T>(capacity);
+		for(size_t i = 0; i < m_size; i++)
+			data[i] = m_data[i];
+		m_data = data;
+		m_capacity = capacity;
+	}
+
+	// forget the array's memory (before the arena is reset)
+	void detach() {m_data = NULL; m_size = 0; m_capacity = 0;}
+
+private:
+	ArenaArray(const ArenaArray&);
+
+	Arena* m_arena;
+	T* m_data;
+	size_t m_size;
+	size_t m_capacity;
+};
+
+#endif
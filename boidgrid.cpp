@@ -0,0 +1,105 @@
+#include "boidgrid.h"
+#include "boidswarm.h"
+
+using namespace std;
+
+// the smallest cell the grid makes; cells of no size (a perception of 0)
+// would put every boid at an infinite cell coordinate
+static const double MIN_CELL_SIZE = 1e-3;
+
+/** @brief BoidGrid::build - Sort all of our boids into grid cells of the given size
+ *
+ * @param BoidSwarm boids
+ * @param double cell_size - the width of a cell; this should be no smaller than
+ *                           the boids' perception distance (cells are never
+ *                           smaller than MIN_CELL_SIZE, which only makes the
+ *                           searches look at more boids)
+ *
+ **/
+void BoidGrid::build(const BoidSwarm& boids, double cell_size)
+{
+	m_cell_size = (cell_size > MIN_CELL_SIZE) ? cell_size : MIN_CELL_SIZE;
+	m_cells.clear();
+	// boids are added in swarm order, so every cell starts out sorted
+	for(int i = 0; i < boids.size(); i++)
+	{
+		Vec3d pos = boids.getPosition(i);
+		Entry e = {pos[0], pos[1], pos[2], i};
+		m_cells[cellKey(pos)].push_back(e);
+	}
+}
+
+/** @brief BoidGrid::getNearbyBoids - Collect every boid within a distance of a position
+ *
+ * Only the 27 cells around the position are searched, so the distance must be
+ * no larger than the cell size. The boids are returned in the same order as they
+ * appear in the swarm, so the rules see exactly what they would have seen looking
+ * at the whole flock (minus boids that are too far away to be noticed anyway).
+ *
+ * @param Vec3d pos - the position to search around
+ * @param double distance - how far away a boid can be and still be found
+ * @param vector<int> nearby - filled with the indices of the boids found
+ * @param vector<int> scratch - working space for merging the cells
+ *
+ **/
+void BoidGrid::getNearbyBoids(const Vec3d& pos, double distance, vector<int>& nearby,
+                              vector<int>& scratch) const
+{
+	int cx = cellCoord(pos[0]);
+	int cy = cellCoord(pos[1]);
+	int cz = cellCoord(pos[2]);
+	// the same test the flocking kernels use (see boidkernel.h), so exactly
+	// the boids they would notice are found
+	double max_length2 = distance * distance;
+	// where each cell's boids start in 'nearby'
+	int runs[28];
+	int num_runs = 0;
+
+	nearby.clear();
+	for(int x = cx - 1; x <= cx + 1; x++)
+		for(int y = cy - 1; y <= cy + 1; y++)
+			for(int z = cz - 1; z <= cz + 1; z++)
+			{
+				unordered_map<long long, vector<Entry> >::const_iterator cell = m_cells.find(cellKey(x, y, z));
+				if(cell == m_cells.end())
+					continue;
+				runs[num_runs] = int(nearby.size());
+				for(const Entry& e : cell->second)
+				{
+					double dx = e.x - pos[0];
+					double dy = e.y - pos[1];
+					double dz = e.z - pos[2];
+					if(dx * dx + dy * dy + dz * dz <= max_length2)
+						nearby.push_back(e.index);
+				}
+				if(int(nearby.size()) > runs[num_runs])
+					num_runs++;
+			}
+	runs[num_runs] = int(nearby.size());
+
+	// each cell is already in swarm order, so merging them puts the whole
+	// list in swarm order
+	mergeRuns(nearby, scratch, runs, num_runs);
+}
+
+/** @brief BoidGrid::cellCoord - Get the cell coordinate along one axis
+ *
+ **/
+int BoidGrid::cellCoord(double x) const
+{
+	return int(floor(x / m_cell_size));
+}
+
+/** @brief BoidGrid::cellKey - Pack a cell's coordinates into a single hash key
+ *
+ **/
+long long BoidGrid::cellKey(int x, int y, int z) const
+{
+	const long long mask = (1 << 21) - 1;
+	return ((x & mask) << 42) | ((y & mask) << 21) | (z & mask);
+}
+
+long long BoidGrid::cellKey(const Vec3d& pos) const
+{
+	return cellKey(cellCoord(pos[0]), cellCoord(pos[1]), cellCoord(pos[2]));
+}
@@ -0,0 +1,39 @@
+// boidgrid.h
+
+// A uniform spatial hash grid used to speed up the boids' neighbor
+// queries. Each boid only needs to look at the 27 cells surrounding
+// its own cell, rather than at every other boid in the flock.
+
+#ifndef BOIDGRID_H
+#define BOIDGRID_H
+
+#include "neighborindex.h"
+#include <unordered_map>
+
+class BoidGrid : public NeighborIndex
+{
+public:
+	BoidGrid() : m_cell_size(1.0) {}
+
+	void build(const BoidSwarm& boids, double cell_size);
+	void getNearbyBoids(const Vec3d& pos, double distance, std::vector<int>& nearby,
+	                    std::vector<int>& scratch) const;
+
+private:
+	// a boid filed in a cell; the position is copied in so a search
+	// reads each cell straight through instead of jumping around the swarm
+	struct Entry
+	{
+		double x, y, z;
+		int index;
+	};
+
+	long long cellKey(const Vec3d& pos) const;
+	long long cellKey(int x, int y, int z) const;
+	int cellCoord(double x) const;
+
+	double m_cell_size;
+	std::unordered_map<long long, std::vector<Entry> > m_cells;
+};
+
+#endif
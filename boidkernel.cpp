@@ -0,0 +1,290 @@
+#include "boidkernel.h"
+#include "boidswarm.h"
+
+// the AVX2 kernel is only built for x86 processors
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BOIDKERNEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define BOIDKERNEL_X86 0
+#endif
+
+// gcc and clang only let a function use AVX2 instructions if it asks for them;
+// visual studio allows the intrinsics anywhere
+#if BOIDKERNEL_X86 && defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+/** @brief addNeighbors - Add neighbors into a kernel's sums one at a time
+ *
+ * @param BoidState others - the state to read the neighbors from
+ * @param int self - the boid the neighbors are for, which is skipped
+ * @param int* neighbors - the candidate neighbors
+ * @param int begin - the first candidate to add
+ * @param int end - one past the last candidate to add
+ * @param double perception2 - the squared distance a boid can notice others within
+ * @param double flock_d2 - the squared distance other boids are kept outside of
+ * @param FlockSums sums - the sums to add to
+ *
+ **/
+static inline void addNeighbors(const BoidState& others, int self, const int* neighbors,
+                                int begin, int end, double perception2, double flock_d2,
+                                FlockSums& sums)
+{
+	const double* pos_x = others.posX();
+	const double* pos_y = others.posY();
+	const double* pos_z = others.posZ();
+	const double* vel_x = others.velX();
+	const double* vel_y = others.velY();
+	const double* vel_z = others.velZ();
+	double x = pos_x[self];
+	double y = pos_y[self];
+	double z = pos_z[self];
+
+	for(int i = begin; i < end; i++)
+	{
+		int j = neighbors[i];
+		if(j == self)
+			continue;
+		double dx = pos_x[j] - x;
+		double dy = pos_y[j] - y;
+		double dz = pos_z[j] - z;
+		double distance2 = dx * dx + dy * dy + dz * dz;
+		// too far away to be noticed
+		if(distance2 > perception2)
+			continue;
+
+		sums.center[0] += pos_x[j];
+		sums.center[1] += pos_y[j];
+		sums.center[2] += pos_z[j];
+		sums.velocity[0] += vel_x[j];
+		sums.velocity[1] += vel_y[j];
+		sums.velocity[2] += vel_z[j];
+		sums.count++;
+		if(distance2 < flock_d2)
+		{
+			sums.separation[0] -= dx;
+			sums.separation[1] -= dy;
+			sums.separation[2] -= dz;
+		}
+	}
+}
+
+/** @brief clearSums - Zero a kernel's sums
+ *
+ **/
+static inline void clearSums(FlockSums& sums)
+{
+	for(int k = 0; k < 3; k++)
+	{
+		sums.center[k] = 0.0;
+		sums.velocity[k] = 0.0;
+		sums.separation[k] = 0.0;
+	}
+	sums.count = 0;
+}
+
+/** @brief flockKernelScalar - Add up a boid's neighbors one at a time
+ *
+ * @param BoidState others - the state to read the neighbors from
+ * @param int self - the boid the neighbors are for, which is skipped
+ * @param int* neighbors - the candidate neighbors
+ * @param int num_neighbors - how many candidates there are
+ * @param double perception2 - the squared distance a boid can notice others within
+ * @param double flock_d2 - the squared distance other boids are kept outside of
+ * @param FlockSums sums - set to the totals over the noticed neighbors
+ *
+ **/
+void flockKernelScalar(const BoidState& others, int self, const int* neighbors,
+                       int num_neighbors, double perception2, double flock_d2,
+                       FlockSums& sums)
+{
+	clearSums(sums);
+	addNeighbors(others, self, neighbors, 0, num_neighbors, perception2, flock_d2, sums);
+}
+
+#if BOIDKERNEL_X86
+
+/** @brief sumLanes - Add up the four lanes of an AVX register
+ *
+ **/
+TARGET_AVX2 static inline double sumLanes(__m256d v)
+{
+	double lanes[4];
+	_mm256_storeu_pd(lanes, v);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+/** @brief flockKernelAVX2 - Add up a boid's neighbors four at a time
+ *
+ * Only call this if cpuHasAVX2() says so. Each group of four candidates is
+ * loaded, measured, and tested at once; the tests become masks that zero
+ * out the candidates that don't count, rather than branching on each one.
+ * Whatever is left over after the last group of four is added up one at a
+ * time.
+ *
+ * @param BoidState others - the state to read the neighbors from
+ * @param int self - the boid the neighbors are for, which is skipped
+ * @param int* neighbors - the candidate neighbors
+ * @param int num_neighbors - how many candidates there are
+ * @param double perception2 - the squared distance a boid can notice others within
+ * @param double flock_d2 - the squared distance other boids are kept outside of
+ * @param FlockSums sums - set to the totals over the noticed neighbors
+ *
+ **/
+TARGET_AVX2 void flockKernelAVX2(const BoidState& others, int self, const int* neighbors,
+                                 int num_neighbors, double perception2, double flock_d2,
+                                 FlockSums& sums)
+{
+	const double* pos_x = others.posX();
+	const double* pos_y = others.posY();
+	const double* pos_z = others.posZ();
+	const double* vel_x = others.velX();
+	const double* vel_y = others.velY();
+	const double* vel_z = others.velZ();
+	__m256d x = _mm256_set1_pd(pos_x[self]);
+	__m256d y = _mm256_set1_pd(pos_y[self]);
+	__m256d z = _mm256_set1_pd(pos_z[self]);
+	__m256d max_distance2 = _mm256_set1_pd(perception2);
+	__m256d min_distance2 = _mm256_set1_pd(flock_d2);
+	__m256d one = _mm256_set1_pd(1.0);
+	__m128i self4 = _mm_set1_epi32(self);
+
+	__m256d center_x = _mm256_setzero_pd(), center_y = _mm256_setzero_pd(), center_z = _mm256_setzero_pd();
+	__m256d vel_sum_x = _mm256_setzero_pd(), vel_sum_y = _mm256_setzero_pd(), vel_sum_z = _mm256_setzero_pd();
+	__m256d sep_x = _mm256_setzero_pd(), sep_y = _mm256_setzero_pd(), sep_z = _mm256_setzero_pd();
+	__m256d count = _mm256_setzero_pd();
+
+	int i = 0;
+	for(; i + 4 <= num_neighbors; i += 4)
+	{
+		__m128i index = _mm_loadu_si128((const __m128i*)(neighbors + i));
+		int first = neighbors[i];
+		// the lists are in swarm order, so runs of boids next to each other are
+		// common (every boid is, without the grid); those can be loaded directly
+		bool in_a_row = (neighbors[i + 3] - first == 3);
+		__m256d nx, ny, nz;
+		if(in_a_row)
+		{
+			nx = _mm256_loadu_pd(pos_x + first);
+			ny = _mm256_loadu_pd(pos_y + first);
+			nz = _mm256_loadu_pd(pos_z + first);
+		}
+		else
+		{
+			nx = _mm256_i32gather_pd(pos_x, index, 8);
+			ny = _mm256_i32gather_pd(pos_y, index, 8);
+			nz = _mm256_i32gather_pd(pos_z, index, 8);
+		}
+		__m256d dx = _mm256_sub_pd(nx, x);
+		__m256d dy = _mm256_sub_pd(ny, y);
+		__m256d dz = _mm256_sub_pd(nz, z);
+		__m256d distance2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+		                                  _mm256_mul_pd(dz, dz));
+
+		// all ones in the lanes that count, all zeros in the rest
+		__m256d is_self = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(index, self4)));
+		__m256d noticed = _mm256_andnot_pd(is_self, _mm256_cmp_pd(distance2, max_distance2, _CMP_LE_OQ));
+		// most candidates are out of range, so skip the rest when none of the four count
+		if(_mm256_movemask_pd(noticed) == 0)
+			continue;
+		__m256d too_close = _mm256_and_pd(noticed, _mm256_cmp_pd(distance2, min_distance2, _CMP_LT_OQ));
+
+		__m256d vx, vy, vz;
+		if(in_a_row)
+		{
+			vx = _mm256_loadu_pd(vel_x + first);
+			vy = _mm256_loadu_pd(vel_y + first);
+			vz = _mm256_loadu_pd(vel_z + first);
+		}
+		else
+		{
+			vx = _mm256_i32gather_pd(vel_x, index, 8);
+			vy = _mm256_i32gather_pd(vel_y, index, 8);
+			vz = _mm256_i32gather_pd(vel_z, index, 8);
+		}
+		center_x = _mm256_add_pd(center_x, _mm256_and_pd(noticed, nx));
+		center_y = _mm256_add_pd(center_y, _mm256_and_pd(noticed, ny));
+		center_z = _mm256_add_pd(center_z, _mm256_and_pd(noticed, nz));
+		vel_sum_x = _mm256_add_pd(vel_sum_x, _mm256_and_pd(noticed, vx));
+		vel_sum_y = _mm256_add_pd(vel_sum_y, _mm256_and_pd(noticed, vy));
+		vel_sum_z = _mm256_add_pd(vel_sum_z, _mm256_and_pd(noticed, vz));
+		sep_x = _mm256_sub_pd(sep_x, _mm256_and_pd(too_close, dx));
+		sep_y = _mm256_sub_pd(sep_y, _mm256_and_pd(too_close, dy));
+		sep_z = _mm256_sub_pd(sep_z, _mm256_and_pd(too_close, dz));
+		count = _mm256_add_pd(count, _mm256_and_pd(noticed, one));
+	}
+
+	sums.center[0] = sumLanes(center_x);
+	sums.center[1] = sumLanes(center_y);
+	sums.center[2] = sumLanes(center_z);
+	sums.velocity[0] = sumLanes(vel_sum_x);
+	sums.velocity[1] = sumLanes(vel_sum_y);
+	sums.velocity[2] = sumLanes(vel_sum_z);
+	sums.separation[0] = sumLanes(sep_x);
+	sums.separation[1] = sumLanes(sep_y);
+	sums.separation[2] = sumLanes(sep_z);
+	sums.count = int(sumLanes(count));
+
+	addNeighbors(others, self, neighbors, i, num_neighbors, perception2, flock_d2, sums);
+}
+
+/** @brief cpuHasAVX2 - Check whether this processor (and operating system) can run
+ *                      the AVX2 kernel
+ *
+ **/
+bool cpuHasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	// the processor has AVX, and the operating system saves the AVX registers
+	__cpuid(info, 1);
+	bool has_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return has_avx && (info[1] & (1 << 5));
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#else
+
+// there's no AVX2 here, so the scalar kernel does the work
+void flockKernelAVX2(const BoidState& others, int self, const int* neighbors,
+                     int num_neighbors, double perception2, double flock_d2,
+                     FlockSums& sums)
+{
+	flockKernelScalar(others, self, neighbors, num_neighbors, perception2, flock_d2, sums);
+}
+
+bool cpuHasAVX2()
+{
+	return false;
+}
+
+#endif
+
+// only ask the processor once
+static const bool has_avx2 = cpuHasAVX2();
+
+/** @brief getFlockKernel - Pick the kernel to run the flocking rules with
+ *
+ * @param bool use_simd - use the AVX2 kernel if the processor supports it
+ * @return FlockKernel - the kernel to use
+ *
+ **/
+FlockKernel getFlockKernel(bool use_simd)
+{
+	if(use_simd && has_avx2)
+		return flockKernelAVX2;
+	return flockKernelScalar;
+}
@@ -0,0 +1,46 @@
+// boidkernel.h
+
+// The inner loop of the flocking rules: given a boid and a list of
+// candidate neighbors, add up the positions and velocities of the ones
+// it notices, and the offsets of the ones that are too close. Distances
+// are compared squared, so there's no sqrt per neighbor.
+//
+// There are two versions. The scalar one works anywhere; the AVX2 one
+// tests four candidates at a time and uses masks instead of branches to
+// leave out the ones that aren't noticed. getFlockKernel() picks the AVX2
+// one only if the processor supports it. The AVX2 kernel sums in four
+// lanes, so its totals can differ from the scalar kernel's in the last
+// bits; use the scalar kernel when results have to match exactly.
+
+#ifndef BOIDKERNEL_H
+#define BOIDKERNEL_H
+
+class BoidState;
+
+// what a kernel adds up over a boid's neighbors
+struct FlockSums
+{
+	double center[3];      // sum of the noticed boids' positions
+	double velocity[3];    // sum of the noticed boids' velocities
+	double separation[3];  // sum of the offsets pointing away from the ones too close
+	int count;             // how many boids were noticed
+};
+
+// called with the state to read, the boid itself (which is skipped), its
+// candidate neighbors (in ascending order, with no repeats), and the squared
+// perception and separation radii
+typedef void (*FlockKernel)(const BoidState& others, int self, const int* neighbors,
+                            int num_neighbors, double perception2, double flock_d2,
+                            FlockSums& sums);
+
+extern void flockKernelScalar(const BoidState& others, int self, const int* neighbors,
+                              int num_neighbors, double perception2, double flock_d2,
+                              FlockSums& sums);
+extern void flockKernelAVX2(const BoidState& others, int self, const int* neighbors,
+                            int num_neighbors, double perception2, double flock_d2,
+                            FlockSums& sums);
+
+extern bool cpuHasAVX2();
+extern FlockKernel getFlockKernel(bool use_simd);
+
+#endif
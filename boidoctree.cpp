@@ -0,0 +1,498 @@
+#include "boidoctree.h"
+#include "boidswarm.h"
+#include "boidkernel.h"
+#include <algorithm>
+
+using namespace std;
+
+/** @brief BoidOctree::build - Sort all of our boids into a fresh tree
+ *
+ * @param BoidSwarm boids
+ * @param double distance - unused; the tree adapts to the boids rather than
+ *                          to the search distance
+ *
+ **/
+void BoidOctree::build(const BoidSwarm& boids, double /*distance*/)
+{
+	m_nodes.clear();
+	m_entries.resize(boids.size());
+	for(int i = 0; i < boids.size(); i++)
+	{
+		Vec3d pos = boids.getPosition(i);
+		Entry e = {pos[0], pos[1], pos[2], i};
+		m_entries[i] = e;
+	}
+	if(m_entries.empty())
+		return;
+
+	addNode(0, int(m_entries.size()));
+	split(0, 0);
+	addTotals(boids.current());
+}
+
+/** @brief BoidOctree::addNode - Add a leaf holding some of the entries, sized to fit them
+ *
+ * @param int begin - the node's first entry
+ * @param int end - one past the node's last entry
+ * @return int - the new node
+ *
+ **/
+int BoidOctree::addNode(int begin, int end)
+{
+	Node node;
+	node.begin = begin;
+	node.end = end;
+	node.first_child = -1;
+	for(int k = 0; k < 3; k++)
+	{
+		node.min[k] = 0.0;
+		node.max[k] = 0.0;
+		node.sum_pos[k] = 0.0;
+		node.sum_vel[k] = 0.0;
+	}
+	if(begin < end)
+	{
+		const Entry& first = m_entries[begin];
+		node.min[0] = node.max[0] = first.x;
+		node.min[1] = node.max[1] = first.y;
+		node.min[2] = node.max[2] = first.z;
+		for(int i = begin + 1; i < end; i++)
+		{
+			const Entry& e = m_entries[i];
+			node.min[0] = min(node.min[0], e.x);
+			node.max[0] = max(node.max[0], e.x);
+			node.min[1] = min(node.min[1], e.y);
+			node.max[1] = max(node.max[1], e.y);
+			node.min[2] = min(node.min[2], e.z);
+			node.max[2] = max(node.max[2], e.z);
+		}
+	}
+	m_nodes.push_back(node);
+	return int(m_nodes.size()) - 1;
+}
+
+/** @brief BoidOctree::split - Split a node into 8 around the middle of its boids,
+ *                             then split those, until every leaf is small enough
+ *
+ * @param int node - the node to split
+ * @param int depth - how deep in the tree the node is
+ *
+ **/
+void BoidOctree::split(int node, int depth)
+{
+	// copied, since adding children can move the nodes around
+	Node n = m_nodes[node];
+	if(n.end - n.begin <= LEAF_SIZE || depth >= MAX_DEPTH ||
+	   (n.min[0] == n.max[0] && n.min[1] == n.max[1] && n.min[2] == n.max[2]))
+	{
+		// keep each leaf in swarm order, so searches can merge leaves rather than sort
+		sort(m_entries.begin() + n.begin, m_entries.begin() + n.end,
+		     [](const Entry& a, const Entry& b) {return a.index < b.index;});
+		return;
+	}
+
+	double mid_x = (n.min[0] + n.max[0]) / 2.0;
+	double mid_y = (n.min[1] + n.max[1]) / 2.0;
+	double mid_z = (n.min[2] + n.max[2]) / 2.0;
+
+	// sort the entries into octants: split on x, then each half on y, then
+	// each quarter on z; the children are then just consecutive ranges
+	Entry* entries = &m_entries[0];
+	int bounds[9];
+	bounds[0] = n.begin;
+	bounds[8] = n.end;
+	bounds[4] = int(partition(entries + bounds[0], entries + bounds[8],
+	                          [=](const Entry& e) {return e.x < mid_x;}) - entries);
+	for(int half = 0; half < 8; half += 4)
+		bounds[half + 2] = int(partition(entries + bounds[half], entries + bounds[half + 4],
+		                                 [=](const Entry& e) {return e.y < mid_y;}) - entries);
+	for(int quarter = 0; quarter < 8; quarter += 2)
+	{
+		int end = (quarter + 2 < 8) ? bounds[quarter + 2] : bounds[8];
+		bounds[quarter + 1] = int(partition(entries + bounds[quarter], entries + end,
+		                                    [=](const Entry& e) {return e.z < mid_z;}) - entries);
+	}
+
+	int first_child = int(m_nodes.size());
+	m_nodes[node].first_child = first_child;
+	for(int c = 0; c < 8; c++)
+		addNode(bounds[c], bounds[c + 1]);
+	for(int c = 0; c < 8; c++)
+		split(first_child + c, depth + 1);
+}
+
+/** @brief BoidOctree::addTotals - Add up the position and velocity of every node's boids
+ *
+ * @param BoidState state - the state the tree was built from
+ *
+ **/
+void BoidOctree::addTotals(const BoidState& state)
+{
+	const double* vel_x = state.velX();
+	const double* vel_y = state.velY();
+	const double* vel_z = state.velZ();
+	// children always come after their parent, so going backwards every
+	// node's children are done before it is
+	for(int n = int(m_nodes.size()) - 1; n >= 0; n--)
+	{
+		Node& node = m_nodes[n];
+		if(node.first_child < 0)
+		{
+			for(int i = node.begin; i < node.end; i++)
+			{
+				const Entry& e = m_entries[i];
+				node.sum_pos[0] += e.x;
+				node.sum_pos[1] += e.y;
+				node.sum_pos[2] += e.z;
+				node.sum_vel[0] += vel_x[e.index];
+				node.sum_vel[1] += vel_y[e.index];
+				node.sum_vel[2] += vel_z[e.index];
+			}
+			continue;
+		}
+		for(int c = 0; c < 8; c++)
+		{
+			const Node& child = m_nodes[node.first_child + c];
+			for(int k = 0; k < 3; k++)
+			{
+				node.sum_pos[k] += child.sum_pos[k];
+				node.sum_vel[k] += child.sum_vel[k];
+			}
+		}
+	}
+}
+
+/** @brief BoidOctree::distance2ToBox - Get the squared distance from a position to
+ *                                      the nearest point of a node's bounds
+ *
+ **/
+double BoidOctree::distance2ToBox(const Node& node, const Vec3d& pos)
+{
+	double d2 = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		double d = 0.0;
+		if(pos[k] < node.min[k])
+			d = node.min[k] - pos[k];
+		else if(pos[k] > node.max[k])
+			d = pos[k] - node.max[k];
+		d2 += d * d;
+	}
+	return d2;
+}
+
+/** @brief BoidOctree::farthest2InBox - Get the squared distance from a position to
+ *                                      the farthest corner of a node's bounds
+ *
+ **/
+double BoidOctree::farthest2InBox(const Node& node, const Vec3d& pos)
+{
+	double d2 = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		double d = max(pos[k] - node.min[k], node.max[k] - pos[k]);
+		d2 += d * d;
+	}
+	return d2;
+}
+
+/** @brief BoidOctree::getNearbyBoids - Collect every boid within a distance of a position
+ *
+ * Any node whose bounds are farther away than the distance is skipped along with
+ * everything under it. The boids found are tested just like the grid and the
+ * flocking kernels test them, and returned in swarm order, so the rules see the
+ * same neighbors whichever search found them.
+ *
+ * @param Vec3d pos - the position to search around
+ * @param double distance - how far away a boid can be and still be found
+ * @param vector<int> nearby - filled with the indices of the boids found
+ * @param vector<int> scratch - working space for merging the leaves
+ *
+ **/
+void BoidOctree::getNearbyBoids(const Vec3d& pos, double distance, vector<int>& nearby,
+                                vector<int>& scratch) const
+{
+	nearby.clear();
+	if(m_nodes.empty())
+		return;
+
+	double max_length2 = distance * distance;
+	// nodes still to look at; a node is swapped for its 8 children, so this
+	// can't hold more than 7 per level of the tree, plus the last 8
+	int stack[7 * MAX_DEPTH + 8];
+	int top = 0;
+	stack[top++] = 0;
+	// where each leaf's boids start in 'nearby'; once there are too many they're
+	// merged into one
+	const int MAX_RUNS = 64;
+	int runs[MAX_RUNS + 1];
+	int num_runs = 0;
+
+	while(top > 0)
+	{
+		const Node& node = m_nodes[stack[--top]];
+		if(node.begin == node.end || distance2ToBox(node, pos) > max_length2)
+			continue;
+		if(node.first_child >= 0)
+		{
+			for(int c = 7; c >= 0; c--)
+				stack[top++] = node.first_child + c;
+			continue;
+		}
+
+		int start = int(nearby.size());
+		int found = start;
+		nearby.resize(start + node.end - node.begin);
+		int* out = &nearby[0];
+		// slightly inside the distance, so rounding can't let in a boid the test
+		// below would have left out
+		if(farthest2InBox(node, pos) < max_length2 * (1.0 - 1e-9))
+		{
+			// the whole leaf is close enough
+			for(int i = node.begin; i < node.end; i++)
+				out[found++] = m_entries[i].index;
+		}
+		else
+		{
+			// write every boid, but only keep the ones that pass, so the test
+			// doesn't need a branch
+			for(int i = node.begin; i < node.end; i++)
+			{
+				const Entry& e = m_entries[i];
+				double dx = e.x - pos[0];
+				double dy = e.y - pos[1];
+				double dz = e.z - pos[2];
+				out[found] = e.index;
+				found += (dx * dx + dy * dy + dz * dz <= max_length2);
+			}
+		}
+		nearby.resize(found);
+		if(found == start)
+			continue;
+		runs[num_runs++] = start;
+		if(num_runs == MAX_RUNS)
+		{
+			runs[num_runs] = found;
+			mergeRuns(nearby, scratch, runs, num_runs);
+			runs[0] = 0;
+			num_runs = 1;
+		}
+	}
+	runs[num_runs] = int(nearby.size());
+	mergeRuns(nearby, scratch, runs, num_runs);
+}
+
+/** @brief BoidOctree::getNearestBoids - Collect the k boids nearest a position
+ *
+ * The nodes are searched nearest first, keeping the k nearest boids seen so far
+ * in a heap with the farthest on top. Once the heap is full, any node farther
+ * away than the top of the heap can't hold anything nearer, so it's skipped.
+ * Boids the same distance away are ranked by index, so the same boids are found
+ * whatever order the tree is searched in.
+ *
+ * @param Vec3d pos - the position to search around
+ * @param int self - a boid to leave out (the one asking), or -1
+ * @param int k - how many boids to find
+ * @param vector<int> nearest - filled with the indices of the boids found, in
+ *                              swarm order
+ * @param vector<pair<double,int>> heap - working space for the search
+ *
+ **/
+void BoidOctree::getNearestBoids(const Vec3d& pos, int self, int k, vector<int>& nearest,
+                                 vector<pair<double, int> >& heap) const
+{
+	nearest.clear();
+	heap.clear();
+	if(m_nodes.empty() || k <= 0)
+		return;
+
+	// nodes still to look at, with how far away they are; children are pushed
+	// farthest first, so the nearest is looked at next
+	pair<double, int> stack[7 * MAX_DEPTH + 8];
+	int top = 0;
+	stack[top++] = make_pair(distance2ToBox(m_nodes[0], pos), 0);
+	while(top > 0)
+	{
+		pair<double, int> next = stack[--top];
+		if(int(heap.size()) == k && next.first > heap.front().first)
+			continue;
+		const Node& node = m_nodes[next.second];
+		if(node.begin == node.end)
+			continue;
+
+		if(node.first_child >= 0)
+		{
+			pair<double, int> children[8];
+			for(int c = 0; c < 8; c++)
+			{
+				int child = node.first_child + c;
+				children[c] = make_pair(distance2ToBox(m_nodes[child], pos), child);
+			}
+			sort(children, children + 8);
+			for(int c = 7; c >= 0; c--)
+				stack[top++] = children[c];
+			continue;
+		}
+
+		for(int i = node.begin; i < node.end; i++)
+		{
+			const Entry& e = m_entries[i];
+			if(e.index == self)
+				continue;
+			double dx = e.x - pos[0];
+			double dy = e.y - pos[1];
+			double dz = e.z - pos[2];
+			pair<double, int> candidate(dx * dx + dy * dy + dz * dz, e.index);
+			if(int(heap.size()) < k)
+			{
+				heap.push_back(candidate);
+				push_heap(heap.begin(), heap.end());
+			}
+			else if(candidate < heap.front())
+			{
+				pop_heap(heap.begin(), heap.end());
+				heap.back() = candidate;
+				push_heap(heap.begin(), heap.end());
+			}
+		}
+	}
+
+	for(size_t i = 0; i < heap.size(); i++)
+		nearest.push_back(heap[i].second);
+	sort(nearest.begin(), nearest.end());
+}
+
+/** @brief BoidOctree::getFlockSums - Add up what a boid's neighbors contribute to the
+ *                                    flocking rules, using the nodes' totals
+ *
+ * A node entirely within perception is added in one go, exactly. A node that
+ * is only partly within perception is opened up, unless it's small next to its
+ * distance (its size is under theta times the distance to its center of mass),
+ * in which case it counts in full if its center of mass is within perception,
+ * or not at all. Anything within flock_d is always counted exactly, so the
+ * separation rule isn't approximated.
+ *
+ * @param BoidState state - the state the tree was built from
+ * @param int self - the boid to add up the neighbors of
+ * @param double perception - how far away a boid can notice other boids
+ * @param double flock_d - how close a boid lets other boids get
+ * @param double theta - how small a node has to be next to its distance to be
+ *                       treated as a single boid
+ * @param FlockSums sums - set to the totals over the noticed neighbors
+ *
+ **/
+void BoidOctree::getFlockSums(const BoidState& state, int self, double perception, double flock_d,
+                              double theta, FlockSums& sums) const
+{
+	for(int k = 0; k < 3; k++)
+	{
+		sums.center[k] = 0.0;
+		sums.velocity[k] = 0.0;
+		sums.separation[k] = 0.0;
+	}
+	sums.count = 0;
+	if(m_nodes.empty())
+		return;
+
+	const double* vel_x = state.velX();
+	const double* vel_y = state.velY();
+	const double* vel_z = state.velZ();
+	Vec3d pos = state.getPosition(self);
+	double perception2 = perception * perception;
+	double flock_d2 = flock_d * flock_d;
+	double theta2 = theta * theta;
+
+	int stack[7 * MAX_DEPTH + 8];
+	int top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		const Node& node = m_nodes[stack[--top]];
+		if(node.begin == node.end)
+			continue;
+		double nearest2 = distance2ToBox(node, pos);
+		if(nearest2 > perception2)
+			continue;
+		double farthest2 = farthest2InBox(node, pos);
+		int count = node.end - node.begin;
+
+		// the whole node is noticed, and is either all too close or all far enough
+		// (with a little room, so rounding can't decide a boid on the boundary)
+		bool all_noticed = (farthest2 < perception2 * (1.0 - 1e-9));
+		bool all_close = (farthest2 < flock_d2 * (1.0 - 1e-9));
+		bool none_close = (nearest2 > flock_d2 * (1.0 + 1e-9));
+		if(!all_noticed && none_close)
+		{
+			// small and far enough away to be treated as one boid at its center of mass
+			double size = max(node.max[0] - node.min[0], max(node.max[1] - node.min[1], node.max[2] - node.min[2]));
+			double dx = node.sum_pos[0] / count - pos[0];
+			double dy = node.sum_pos[1] / count - pos[1];
+			double dz = node.sum_pos[2] / count - pos[2];
+			double center2 = dx * dx + dy * dy + dz * dz;
+			if(size * size < theta2 * center2)
+			{
+				if(center2 <= perception2)
+					all_noticed = true;
+				else
+					continue;
+			}
+		}
+		if(all_noticed && (all_close || none_close))
+		{
+			for(int k = 0; k < 3; k++)
+			{
+				sums.center[k] += node.sum_pos[k];
+				sums.velocity[k] += node.sum_vel[k];
+				if(all_close)
+					sums.separation[k] -= node.sum_pos[k] - count * pos[k];
+			}
+			sums.count += count;
+			continue;
+		}
+
+		if(node.first_child >= 0)
+		{
+			for(int c = 7; c >= 0; c--)
+				stack[top++] = node.first_child + c;
+			continue;
+		}
+		for(int i = node.begin; i < node.end; i++)
+		{
+			const Entry& e = m_entries[i];
+			double dx = e.x - pos[0];
+			double dy = e.y - pos[1];
+			double dz = e.z - pos[2];
+			double distance2 = dx * dx + dy * dy + dz * dz;
+			if(distance2 > perception2)
+				continue;
+			sums.center[0] += e.x;
+			sums.center[1] += e.y;
+			sums.center[2] += e.z;
+			sums.velocity[0] += vel_x[e.index];
+			sums.velocity[1] += vel_y[e.index];
+			sums.velocity[2] += vel_z[e.index];
+			sums.count++;
+			if(distance2 < flock_d2)
+			{
+				sums.separation[0] -= dx;
+				sums.separation[1] -= dy;
+				sums.separation[2] -= dz;
+			}
+		}
+	}
+
+	// the boid itself was counted (it's no distance away), so take it back out
+	Vec3d vel = state.getVelocity(self);
+	for(int k = 0; k < 3; k++)
+	{
+		sums.center[k] -= pos[k];
+		sums.velocity[k] -= vel[k];
+	}
+	sums.count--;
+	if(sums.count == 0)
+		for(int k = 0; k < 3; k++)
+		{
+			sums.center[k] = 0.0;
+			sums.velocity[k] = 0.0;
+		}
+}
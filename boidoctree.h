@@ -0,0 +1,71 @@
+// boidoctree.h
+
+// An adaptive octree for the boids' neighbor queries. Unlike the uniform
+// grid, a node only splits when it holds too many boids, and it splits
+// around the middle of the boids it actually holds. When the flock packs
+// tightly together (circling the plant, say) the crowded parts end up in
+// small nodes, so a search still only looks at boids near the one asking.
+//
+// The tree can also find a boid's k nearest neighbors, however near or far
+// they are, for the topological flocking mode (see SimParams::nearest).
+//
+// Every node also keeps the total position and velocity of its boids, so
+// the cohesion and alignment rules can add up a whole node at once, and
+// can treat a small, distant node as a single boid at its center of mass
+// (like Barnes-Hut; see SimParams::theta).
+
+#ifndef BOIDOCTREE_H
+#define BOIDOCTREE_H
+
+#include "neighborindex.h"
+#include <utility>
+
+class BoidState;
+struct FlockSums;
+
+class BoidOctree : public NeighborIndex
+{
+public:
+	BoidOctree() {}
+
+	void build(const BoidSwarm& boids, double distance);
+	void getNearbyBoids(const Vec3d& pos, double distance, std::vector<int>& nearby,
+	                    std::vector<int>& scratch) const;
+	void getNearestBoids(const Vec3d& pos, int self, int k, std::vector<int>& nearest,
+	                     std::vector<std::pair<double, int> >& heap) const;
+	void getFlockSums(const BoidState& state, int self, double perception, double flock_d,
+	                  double theta, FlockSums& sums) const;
+
+private:
+	// a node splits when it holds more boids than this
+	static const int LEAF_SIZE = 32;
+	// and stops splitting this deep, in case many boids share one position
+	static const int MAX_DEPTH = 24;
+
+	// a boid filed in the tree, with its position copied in
+	struct Entry
+	{
+		double x, y, z;
+		int index;
+	};
+
+	struct Node
+	{
+		double min[3], max[3];  // bounds of the boids in the node
+		int begin, end;         // the node's boids in m_entries
+		int first_child;        // the first of 8 children, or -1 for a leaf
+		double sum_pos[3];      // total position of the boids in the node
+		double sum_vel[3];      // total velocity of the boids in the node
+	};
+
+	int addNode(int begin, int end);
+	void split(int node, int depth);
+	void addTotals(const BoidState& state);
+	static double distance2ToBox(const Node& node, const Vec3d& pos);
+	static double farthest2InBox(const Node& node, const Vec3d& pos);
+
+	std::vector<Node> m_nodes;
+	std::vector<Entry> m_entries;
+};
+
+#endif
@@ -1,4 +1,14 @@
 #include "boids.h"
+#include "boidgrid.h"
+#include "boidoctree.h"
+#include "boidkernel.h"
+#include "verletlists.h"
+#include "plantbvh.h"
+#include "plantsdf.h"
+#include "taskpool.h"
+#include "checkpoint.h"
+#include <algorithm>
+#include <chrono>
 
 using namespace std;
 
@@ -7,211 +17,565 @@ bool wind_active = false;
 int wind_timer = 0;
 double wind_speed;
 
+// where the simulation's random numbers come from (see seedBoids())
+static unsigned long long boids_seed = 1;
+static RandomStream init_rng(1, STREAM_INIT);
+static RandomStream wind_rng(1, STREAM_WIND);
+
+// neighbor searches, kept around so their memory can be reused between steps
+static BoidGrid boid_grid;
+static BoidOctree boid_octree;
+
+// each boid's neighbors, kept from step to step when params.skin is above 0,
+// and how many steps used them and how many of those had to remake them
+static VerletLists verlet_lists;
+static long long neighbor_list_steps = 0;
+static long long neighbor_list_rebuilds = 0;
+
+// steps until the boids are next sorted by position
+static int steps_until_sort = 0;
+
+// how long each species has spent being moved
+static double species_seconds[MAX_SPECIES] = {0.0};
+
+// threads to move the boids with, and how many boids each thread takes at a time
+static TaskPool boid_pool;
+const int MOVE_CHUNK_SIZE = 256;
+
+// memory that's only needed during a step, given back all at once at the start
+// of the next one
+static Arena step_arena;
+
+// each thread's working space for neighbor searches
+struct NeighborLists
+{
+	vector<int> nearby;
+	vector<int> scratch;
+	vector<pair<double, int> > heap;
+};
+static vector<NeighborLists> worker_lists;
+
+/** @brief seedBoids - Seed the simulation's random numbers and calm the wind, so
+ *                     a run can be repeated exactly
+ *
+ * @param unsigned long long seed - the same seed always gives the same run
+ *
+ **/
+void seedBoids(unsigned long long seed)
+{
+	boids_seed = seed;
+	init_rng.seed(seed, STREAM_INIT);
+	wind_rng.seed(seed, STREAM_WIND);
+	wind_active = false;
+	wind_timer = 0;
+	wind_speed = 0.0;
+	neighbor_list_steps = 0;
+	neighbor_list_rebuilds = 0;
+	steps_until_sort = 0;
+	for(int s = 0; s < MAX_SPECIES; s++)
+		species_seconds[s] = 0.0;
+}
+
 /** @brief initializeBoids - Initialize our boids at random positions
  *
- * @param vector<Boid*> boids
- * @returns vector<Boid*> - a vector containing pointers to the initialized boids
+ * @param BoidSwarm boids - the swarm to add the new boids to
+ * @param int num_boids - the number of boids to add
+ * @param int species - the species of the new boids
  *
  **/
-vector<Boid*> initializeBoids(vector<Boid*> boids, int num_boids) 
+void initializeBoids(BoidSwarm& boids, int num_boids, int species) 
 {
+	boids.reserve(boids.size() + num_boids);
 	for(int i = 0; i < num_boids; i++)
 	{
-		boids.push_back(new Boid(getRandomPositionVector(), getRandomVelocityVector()));
+		Vec3d pos = getRandomPositionVector(init_rng);
+		boids.spawnBoid(pos, getRandomVelocityVector(init_rng), species);
 	}
-	return boids;
+	verlet_lists.invalidate();
 }
 
-/** @brief moveBoids - Move our boids according to the rules
+/** @brief setBoidCount - Grow or shrink the flock to a number of boids
  *
- * @param vector<Boid*> boids
+ * The boids are split evenly between the species, with the first few species
+ * taking one more when they don't divide evenly. New boids start at random
+ * positions, like initializeBoids(). When a species shrinks, its newest boids
+ * are despawned first.
+ *
+ * @param BoidSwarm boids
+ * @param int num_boids - how many boids the flock should have
+ * @param int num_species - how many species to split them between
  *
  **/
-void moveBoids(vector<Boid*> boids) 
+void setBoidCount(BoidSwarm& boids, int num_boids, int num_species)
 {
-	Vec3d v1 = Vec3d();
-	Vec3d v2 = Vec3d();
-	Vec3d v3 = Vec3d();
-	Vec3d v4 = Vec3d();
-	Vec3d v5 = Vec3d();
-	Vec3d v6 = Vec3d();
+	num_boids = max(num_boids, 0);
+	num_species = min(max(num_species, 1), MAX_SPECIES);
+	for(int s = 0; s < MAX_SPECIES; s++)
+	{
+		int count = 0;
+		if(s < num_species)
+			count = num_boids / num_species + ((s < num_boids % num_species) ? 1 : 0);
+		if(count > boids.getSpeciesCount(s))
+			initializeBoids(boids, count - boids.getSpeciesCount(s), s);
+		while(boids.getSpeciesCount(s) > count)
+			boids.despawnBoid(boids.getHandle(boids.getSpeciesBegin(s + 1) - 1));
+	}
+}
 
-	// handle wind in a separate function
-	handleWind();
+/** @brief getNeighborListCounts - Get how often the kept neighbor lists had to be
+ *                                remade (see SimParams::skin), since the last seedBoids()
+ *
+ * @param long long steps - set to how many steps used the lists
+ * @param long long rebuilds - set to how many of those steps remade them
+ *
+ **/
+void getNeighborListCounts(long long& steps, long long& rebuilds)
+{
+	steps = neighbor_list_steps;
+	rebuilds = neighbor_list_rebuilds;
+}
 
-	for(Boid* b : boids)
-	{
-		v1 = b->flyTowardsCenterOfMass(boids);
-		v2 = b->keepDistance(boids);
-		v3 = b->matchVelocity(boids);
-		v4 = b->flyTowardsPlant();
-		v5 = b->straightenPath();
-		b->perch();
-
-		// this will cause birds to 'perch' on the ground for a short time
-		if (b->perching)
-		{
-			if(b->getPerchTimer() > 0)
-			{
-				b->decrPerchTimer();
-				continue;
-			}
-			else 
-				b->perching = false;
-		}
+/** @brief getSpeciesTimes - Get how long each species has spent being moved, since
+ *                           the last seedBoids()
+ *
+ * @param double seconds - filled in with each species' time, in seconds
+ *
+ **/
+void getSpeciesTimes(double seconds[MAX_SPECIES])
+{
+	for(int s = 0; s < MAX_SPECIES; s++)
+		seconds[s] = species_seconds[s];
+}
 
-		// this will create periodic gusts of wind that last a short time
-		if(wind_active)
-		{
-			if(wind_timer > 0)
-				v6 = b->addWind();
-		}
+/** @brief saveBoids - Save the flock, and the rest of the simulation's state, to a
+ *                     checkpoint (see checkpoint.h)
+ *
+ * Along with the swarm go the random number streams, the wind and the
+ * countdown to the next sort: everything the next step depends on besides
+ * its settings, so a loaded checkpoint carries on exactly as the saved run
+ * would have.
+ *
+ * @param CheckpointWriter out
+ * @param BoidSwarm boids
+ *
+ **/
+void saveBoids(CheckpointWriter& out, const BoidSwarm& boids)
+{
+	out.beginSection("SIMS");
+	out.write(boids_seed);
+	out.write(init_rng.getCounter());
+	out.write(wind_rng.getCounter());
+	out.write((unsigned char)wind_active);
+	out.write(wind_timer);
+	out.write(wind_speed);
+	out.write(steps_until_sort);
+	out.endSection();
+	boids.save(out);
+}
 
-		b->setVelocity(b->getVelocity() + v1 + v2 + v3 + v4 + v5 + v6);
-		b->setPosition(b->getPosition() + b->getVelocity());
-		b->boundPosition();
-		b->limitVelocity();
+/** @brief loadBoids - Load the flock, and the rest of the simulation's state, from a
+ *                     checkpoint written by saveBoids()
+ *
+ * @param CheckpointReader in
+ * @param BoidSwarm boids - replaced with the saved swarm
+ * @return bool - false if the checkpoint is missing any of it, in which case
+ *                nothing is changed
+ *
+ **/
+bool loadBoids(CheckpointReader& in, BoidSwarm& boids)
+{
+	unsigned long long seed, init_counter, wind_counter;
+	unsigned char active;
+	int timer, until_sort;
+	double speed;
+	if(!in.findSection("SIMS") || !in.read(seed) || !in.read(init_counter) || !in.read(wind_counter) ||
+	   !in.read(active) || !in.read(timer) || !in.read(speed) || !in.read(until_sort))
+		return false;
+	if(!boids.load(in))
+		return false;
 
-	}
-	// decrement wind counter
-	if (wind_active && wind_timer > 0)
-		wind_timer--;
+	// start over from the saved seed, then move the streams along to where they were
+	seedBoids(seed);
+	init_rng.setCounter(init_counter);
+	wind_rng.setCounter(wind_counter);
+	wind_active = (active != 0);
+	wind_timer = timer;
+	wind_speed = speed;
+	steps_until_sort = until_sort;
+	// the kept neighbor lists were for the flock before loading
+	verlet_lists.invalidate();
+	return true;
 }
 
-/** @brief drawBoids - Draw all of our boids in the sample model space
+/** @brief getSpeciesParams - Get the settings one species runs with
  *
- * @param vector<Boid*> boids
+ * @param SimParams params - the settings for the whole flock
+ * @param int species
+ * @return SimParams - params, with species 1 and up's own settings filled in
  *
  **/
-void drawBoids(vector<Boid*> boids) 
+static SimParams getSpeciesParams(const SimParams& params, int species)
 {
-	Vec3d boid_pos = Vec3d();
-	int boid_color = int (VAL(BOID_COLOR) + 0.5);
-	for(Boid* b : boids)
+	SimParams species_params = params;
+	if(species > 0)
 	{
-		glPushMatrix();
-			boid_pos = b->getPosition();
-			glTranslated(boid_pos[0], boid_pos[1], boid_pos[2]);
-			drawSphere(BOID_SIZE);	
-			// show direction of velocity with a line, if setting is on
-			if(VAL(SHOW_DIR))
-			{
-				setDiffuseColor(COLOR_RED);
-				b->drawDirectionLine();
-				setColor(boid_color);
-			}
-		glPopMatrix();
+		species_params.perception = params.species[species - 1].perception;
+		species_params.flock_d = params.species[species - 1].flock_d;
+		species_params.flock_speed = params.species[species - 1].flock_speed;
 	}
+	return species_params;
 }
 
-/** @brief Boid::centerOfMass - Rule 1 - boids try to fly towards
- *                              the center of mass of neighboring boids
- *                              (cohesion)
+/** @brief sumNeighbors - Add up what a boid's neighbors contribute to the flocking rules
  *
- * @param vector<Boid*> boids
- * @returns Vec3d - a vector that when added to the boid's velocity, incrementally moves the boid
- *                  towards neighbors' centers of mass
- *                - or, a zero vector if there are no neighbors
+ * @param BoidState last - the state as of the last step, to read neighbors from
+ * @param int i - the boid to add up the neighbors of
+ * @param int* neighbors - the indices of the boids that might be noticed
+ * @param int count - how many neighbors there are
+ * @param SimParams params
+ * @param FlockSums sums - set to the totals over the noticed neighbors
  *
  **/
-Vec3d Boid::flyTowardsCenterOfMass(vector<Boid*> boids)
+static void sumNeighbors(const BoidState& last, int i, const int* neighbors, int count,
+                         const SimParams& params, FlockSums& sums)
 {
-	Vec3d center = Vec3d();
-	int boids_nearby = 0;
-	// find visible neighbors' center of mass
-	for(Boid* b : boids)
+	// in the topological mode the neighbors were picked by how near they are,
+	// so every one of them is noticed
+	double perception2 = (params.nearest > 0) ? HUGE_VAL : params.perception * params.perception;
+	FlockKernel kernel = getFlockKernel(params.simd);
+	kernel(last, i, neighbors, count, perception2, params.flock_d * params.flock_d, sums);
+}
+
+/** @brief sumSpeciesNeighbors - Add up what a boid's neighbors contribute to the flocking
+ *                               rules, in a flock of more than one species
+ *
+ * The neighbors are in swarm order, so the boid's own species is a single run
+ * of them, and is handed to the kernel on its own. The boids of the other
+ * species only add to the avoidance offsets.
+ *
+ * @param BoidState last - the state as of the last step, to read neighbors from
+ * @param int i - the boid to add up the neighbors of
+ * @param int* neighbors - the indices of the boids that might be noticed
+ * @param int count - how many neighbors there are
+ * @param int species_begin - the first boid of the boid's species
+ * @param int species_end - one past the last boid of the boid's species
+ * @param SimParams params - the species' settings
+ * @param FlockSums sums - set to the totals over the noticed boids of the same species
+ * @param Vec3d avoid - set to the sum of the offsets pointing away from the boids of
+ *                      other species that are within params.avoid_d
+ *
+ **/
+static void sumSpeciesNeighbors(const BoidState& last, int i, const int* neighbors, int count,
+                                int species_begin, int species_end, const SimParams& params,
+                                FlockSums& sums, Vec3d& avoid)
+{
+	int first = int(lower_bound(neighbors, neighbors + count, species_begin) - neighbors);
+	int end = int(lower_bound(neighbors + first, neighbors + count, species_end) - neighbors);
+	FlockKernel kernel = getFlockKernel(params.simd);
+	kernel(last, i, neighbors + first, end - first, params.perception * params.perception,
+	       params.flock_d * params.flock_d, sums);
+
+	// every boid of another species that's too close is also noticed, so the
+	// kernel's separation sum is the avoidance
+	double avoid2 = params.avoid_d * params.avoid_d;
+	FlockSums before, after;
+	kernel(last, i, neighbors, first, avoid2, avoid2, before);
+	kernel(last, i, neighbors + end, count - end, avoid2, avoid2, after);
+	avoid = Vec3d(before.separation[0] + after.separation[0],
+	              before.separation[1] + after.separation[1],
+	              before.separation[2] + after.separation[2]);
+}
+
+/** @brief moveBoid - Move a single boid according to the rules
+ *
+ * @param Boid b - the boid to move, in the state being written
+ * @param FlockSums sums - what the boid's neighbors add up to (see sumNeighbors())
+ * @param Vec3d avoid - the offsets away from boids of other species that are too
+ *                      close (see sumSpeciesNeighbors())
+ * @param SimParams params - the settings of the boid's species
+ *
+ **/
+static void moveBoid(Boid b, const FlockSums& sums, const Vec3d& avoid, const SimParams& params)
+{
+	Vec3d v1 = Vec3d();
+	Vec3d v2 = Vec3d();
+	Vec3d v3 = Vec3d();
+	Vec3d v4 = Vec3d();
+	Vec3d v5 = Vec3d();
+	Vec3d v6 = Vec3d();
+	Vec3d v7 = Vec3d();
+	Vec3d v8 = Vec3d();
+
+	b.flock(sums, params, v1, v2, v3);
+	v4 = b.flyTowardsPlant(params);
+	v5 = b.straightenPath(params);
+	v8 = b.avoidPlant(params);
+	b.perch(params);
+
+	// this will cause birds to 'perch' on the ground for a short time (boids
+	// that were already perching aren't moved at all until their timers run
+	// out, see BoidSwarm::getActiveBoids())
+	if (b.isPerching())
 	{
-		if(b != this)
+		if(b.getPerchTimer() > 0)
 		{
-			if(b->isNoticed(this))
-			{
-				center = center + b->getPosition();
-				boids_nearby++;
-			}
+			b.decrPerchTimer();
+			return;
 		}
+		else 
+			b.setPerching(false);
 	}
-	// no neighbors nearby, return zero vector
-	if(center.iszero())
-		return center;
 
-	// otherwise, start incrementally moving boid towards center of mass
-	center = center / boids_nearby;
-	return (center - this->getPosition()) / 100.0;
+	// this will create periodic gusts of wind that last a short time
+	if(wind_active)
+	{
+		if(wind_timer > 0)
+			v6 = b.addWind(params);
+	}
+
+	// keep away from the other species the way separation keeps away from
+	// boids of the same one
+	v7 = avoid * params.flock_speed;
+
+	b.setVelocity(b.getVelocity() + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8);
+	b.setPosition(b.getPosition() + b.getVelocity());
+	b.boundPosition(params);
+	b.limitVelocity(params);
 }
 
-/** @brief Boid::keepDistance - Rule 2 - boids try to keep a small distance
- *                              away from other boids
- *                              (separation)
+/** @brief moveBoids - Move our boids according to the rules
  *
- * @param vector<Boid*> boids
- * @returns Vec3d - a vector that when added to the boid's velocity, moves it away from 
- *                  neighboring boids
- *                - or, a zero vector if there are no neighbors
+ * Every boid reacts to where its neighbors were at the end of the last
+ * step, so the result doesn't depend on the order the boids are moved in,
+ * and the boids can be split up between params.threads threads.
+ *
+ * Unless the neighbor search setting is SEARCH_ALL, the boids are sorted
+ * into a grid or an octree first, and each boid only looks at the boids
+ * the search finds within its perception. Otherwise every boid looks at
+ * the whole flock.
+ *
+ * In the topological mode (params.nearest above 0) each boid looks at just
+ * its nearest few boids instead, found with the octree whatever the search
+ * setting, so each boid costs the same however crowded the flock gets.
+ *
+ * Otherwise, if params.theta is above 0, the boids are added up straight from
+ * the octree's per-node totals: whole nodes within perception are added at
+ * once, and far away nodes that are small enough (for theta) are treated as
+ * a single boid at their center of mass.
+ *
+ * Otherwise, if params.skin is above 0, each boid's neighbors (within
+ * perception plus the skin) are kept from step to step, and only searched for
+ * again once some boid has moved more than half the skin.
+ *
+ * Only the swarm's active boids are moved; perching boids stay where they
+ * are until their timers run out, but are still seen by the others.
+ *
+ * Every params.sort_interval steps the boids are sorted by position first
+ * (see BoidSwarm::sortByPosition()), which changes their indices but not
+ * their handles.
+ *
+ * Each species is moved in a loop of its own, with its own settings (see
+ * SimParams::species), and only flocks with boids of its own species. When
+ * the flock has more than one species, a single search (or set of kept lists)
+ * built for the longest distance any species looks is shared between them,
+ * and boids of other species that it finds within params.avoid_d are
+ * avoided. The topological and far-field modes only work with one species.
+ *
+ * @param BoidSwarm boids
+ * @param SimParams params - the settings to run this step with
  *
  **/
-Vec3d Boid::keepDistance(vector<Boid*> boids)
+void moveBoids(BoidSwarm& boids, const SimParams& params) 
 {
-	Vec3d c = Vec3d();
-	// look at visible neighbors and sum the distances between them and this boid
-	for(Boid* b : boids)
+	// each species' settings, and the farthest any boid needs to look
+	SimParams species_params[MAX_SPECIES];
+	bool mixed = (boids.getSpeciesCount(0) != boids.size());
+	double distance = params.perception;
+	for(int s = 0; s < MAX_SPECIES; s++)
+	{
+		species_params[s] = getSpeciesParams(params, s);
+		if(boids.getSpeciesCount(s) > 0)
+			distance = max(distance, species_params[s].perception);
+	}
+	if(mixed)
+		distance = max(distance, params.avoid_d);
+
+	bool topological = !mixed && (params.nearest > 0);
+	bool far_field = !mixed && !topological && params.theta > 0.0;
+	bool kept_lists = !topological && !far_field && params.skin > 0.0;
+	if(params.sort_interval > 0 && --steps_until_sort <= 0)
+	{
+		boids.sortByPosition();
+		// the lists hold indices, which sorting just changed
+		verlet_lists.invalidate();
+		steps_until_sort = params.sort_interval;
+	}
+	NeighborIndex* search = NULL;
+	if(topological || far_field)
+		search = &boid_octree;
+	else if(params.neighbor_search == SEARCH_GRID)
+		search = &boid_grid;
+	else if(params.neighbor_search == SEARCH_OCTREE)
+		search = &boid_octree;
+	boid_pool.setThreadCount(params.threads);
+	step_arena.reset();
+	int* everyone = NULL;
+	if(kept_lists)
 	{
-		if(b != this)
+		neighbor_list_steps++;
+		if(verlet_lists.isStale(boids, distance, params.skin))
 		{
-			if(b->isNoticed(this))
+			if(search)
+				search->build(boids, distance + params.skin);
+			verlet_lists.build(boids, search, distance, params.skin, boid_pool, MOVE_CHUNK_SIZE);
+			neighbor_list_rebuilds++;
+		}
+	}
+	else if(search)
+		search->build(boids, distance);
+	else
+	{
+		everyone = step_arena.allocateArray<int>(boids.size());
+		for(int i = 0; i < boids.size(); i++)
+			everyone[i] = i;
+	}
+
+	// handle wind in a separate function
+	handleWind(params);
+
+	// read from the last step's state, write to the next one
+	const BoidState& last = boids.current();
+	BoidState& next = boids.beginStep();
+	// boids still perching sit this step out; they stay put in the next state
+	const vector<int>& active = boids.getActiveBoids();
+
+	if(int(worker_lists.size()) < boid_pool.getThreadCount())
+		worker_lists.resize(boid_pool.getThreadCount());
+
+	for(int s = 0; s < MAX_SPECIES; s++)
+	{
+		if(boids.getSpeciesCount(s) == 0)
+			continue;
+		// the active list is in index order, so the species' active boids sit together
+		int species_begin = boids.getSpeciesBegin(s);
+		int species_end = boids.getSpeciesBegin(s + 1);
+		const int* first = active.data() + (lower_bound(active.begin(), active.end(), species_begin) - active.begin());
+		int count = int(active.data() + (lower_bound(active.begin(), active.end(), species_end) - active.begin()) - first);
+		const SimParams& p = species_params[s];
+		// with more than one species, each boid looks as far as its species
+		// needs, or far enough to avoid the others
+		double search_distance = mixed ? max(p.perception, p.avoid_d) : p.perception;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		boid_pool.parallelFor(count, MOVE_CHUNK_SIZE, [&](int begin, int end, int worker)
+		{
+			NeighborLists& lists = worker_lists[worker];
+			for(int k = begin; k < end; k++)
 			{
-			if((b->getPosition() - this->getPosition()).length() < (VAL(FLOCK_D)))
-				c = c - (b->getPosition() - this->getPosition());
+				int i = first[k];
+				const int* neighbors = everyone;
+				int num_neighbors = boids.size();
+				FlockSums sums;
+				Vec3d avoid = Vec3d();
+				if(far_field)
+				{
+					boid_octree.getFlockSums(last, i, p.perception, p.flock_d, p.theta, sums);
+					moveBoid(Boid(&next, i), sums, avoid, p);
+					continue;
+				}
+				if(kept_lists)
+				{
+					neighbors = verlet_lists.getNeighbors(i);
+					num_neighbors = verlet_lists.getNeighborCount(i);
+				}
+				else if(search)
+				{
+					if(topological)
+						boid_octree.getNearestBoids(last.getPosition(i), i, p.nearest, lists.nearby, lists.heap);
+					else
+						search->getNearbyBoids(last.getPosition(i), search_distance, lists.nearby, lists.scratch);
+					neighbors = lists.nearby.data();
+					num_neighbors = int(lists.nearby.size());
+				}
+				if(mixed)
+					sumSpeciesNeighbors(last, i, neighbors, num_neighbors, species_begin, species_end, p, sums, avoid);
+				else
+					sumNeighbors(last, i, neighbors, num_neighbors, p, sums);
+				moveBoid(Boid(&next, i), sums, avoid, p);
 			}
-		}
+		});
+
+		species_seconds[s] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
 	}
-	// smooth the movement a bit
-	return c*VAL(FLOCK_SPEED);
+	boids.endStep();
+
+	// decrement wind counter
+	if (wind_active && wind_timer > 0)
+		wind_timer--;
 }
 
-/** @brief Boid::matchVelocity - Rule 3 - boids try to match velocity with nearby boids
- *                               (alignment)
+/** @brief Boid::flock - Apply the three flocking rules to what the neighboring
+ *                       boids add up to:
+ *                       Rule 1 - boids try to fly towards the center of mass of
+ *                                neighboring boids (cohesion)
+ *                       Rule 2 - boids try to keep a small distance away from
+ *                                other boids (separation)
+ *                       Rule 3 - boids try to match velocity with nearby boids
+ *                                (alignment)
  *
- * @param vector<Boid*> boids
- * @returns Vec3d - a vector that when added to the boid's velocity, slowly matches its velocity 
- *                  to that of neighboring boids
- *                - or, a zero vector if there are no neighbors
+ * The neighbors are added up beforehand, in a single pass (see sumNeighbors()),
+ * or from the octree's per-node totals when distant boids are approximated.
+ *
+ * @param FlockSums sums - the totals over the boids this boid notices
+ * @param SimParams params
+ * @param Vec3d cohesion - set to a vector that incrementally moves the boid towards
+ *                         neighbors' center of mass, or a zero vector if there are no neighbors
+ * @param Vec3d separation - set to a vector that moves the boid away from neighboring boids,
+ *                           or a zero vector if there are no neighbors
+ * @param Vec3d alignment - set to a vector that slowly matches the boid's velocity to that of
+ *                          neighboring boids, or a zero vector if there are no neighbors
  *
  **/
-Vec3d Boid::matchVelocity(vector<Boid*> boids)
+void Boid::flock(const FlockSums& sums, const SimParams& params,
+                 Vec3d& cohesion, Vec3d& separation, Vec3d& alignment)
 {
-	Vec3d velocity = Vec3d();
-	int boids_nearby = 0;
-	// add up visible neighbors' velocities
-	for(Boid* b : boids)
+	Vec3d center = Vec3d(sums.center[0], sums.center[1], sums.center[2]);
+	Vec3d c = Vec3d(sums.separation[0], sums.separation[1], sums.separation[2]);
+	Vec3d velocity = Vec3d(sums.velocity[0], sums.velocity[1], sums.velocity[2]);
+	int boids_nearby = sums.count;
+
+	// cohesion - start incrementally moving boid towards center of mass
+	if(center.iszero())
+		cohesion = center;
+	else
 	{
-		if(b != this)
-		{
-			if(b->isNoticed(this))
-			{
-				velocity = velocity + b->getVelocity();
-				boids_nearby++;
-			}
-			else continue;
-		}
+		center = center / boids_nearby;
+		cohesion = (center - this->getPosition()) / 100.0;
+	}
+
+	// separation - smooth the movement a bit
+	separation = c*params.flock_speed;
+
+	// alignment - calculate average velocity slowly match it
+	if(velocity.iszero())
+		alignment = velocity;
+	else
+	{
+		velocity = velocity / (boids_nearby);
+		alignment = (velocity - this->getVelocity()) / 8.0;
 	}
-	// no neighbors nearby, return zero vector
-	if(velocity.iszero()) 
-		return velocity;
-	// otherwise, calculate average velocity slowly match it
-	velocity = velocity / (boids_nearby);
-	return (velocity - this->getVelocity()) / 8.0;
 }
 
 /** @brief Boid::flyTowardsPlant - This will cause the boid to fly towards the plant in the center
  *
- * @param vector<Boid*> boids
+ * @param SimParams params
  * @return Vec3d - a vector that when added to the boid's velocity incrementally moves the boid
  *                  towards the plant in the center of the screen
  *
  **/
-Vec3d Boid::flyTowardsPlant()
+Vec3d Boid::flyTowardsPlant(const SimParams& params)
 {
-	if(VAL(CIRCLE_PLANT))
+	if(params.circle_plant)
 	{
 		Vec3d place = Vec3d(0.0, 3.0, 0.0);
 		return (place - this->getPosition()) / 180;
@@ -219,21 +583,51 @@ Vec3d Boid::flyTowardsPlant()
 	else return Vec3d();
 }
 
+/** @brief Boid::avoidPlant - Steer the boid away from the plant's branches and leaves
+ *                            when it gets close to them
+ *
+ * The nearest part of the plant is looked up in the plant's distance field if
+ * there is one, which costs the same however big the plant is, or else found
+ * with the plant's BVH, which costs about log(branches) per boid.
+ *
+ * @param SimParams params
+ * @return Vec3d - a vector pointing straight away from the nearest branch, stronger
+ *                 the closer the boid is (the boid's top speed at the surface),
+ *                 or a zero vector if the boid isn't close to the plant
+ *
+ **/
+Vec3d Boid::avoidPlant(const SimParams& params)
+{
+	if(params.plant_avoid_d <= 0.0)
+		return Vec3d();
+	PlantHit hit;
+	if(params.plant_sdf)
+	{
+		hit.distance = params.plant_sdf->getDistance(this->getPosition(), hit.away);
+		if(hit.distance > params.plant_avoid_d)
+			return Vec3d();
+	}
+	else if(!params.plant || !params.plant->findNearest(this->getPosition(), params.plant_avoid_d, hit))
+		return Vec3d();
+	double strength = 1.0 - max(hit.distance, 0.0) / params.plant_avoid_d;
+	return Vec3d(hit.away[0], hit.away[1], hit.away[2]) * (params.flock_speed * strength);
+}
+
 /** @brief Boid::straightenPath - This slightly straightens the path the boid is currently on-
  *                                used in conjunction with flyTowardsPlant() to create a more rounded
  *                                path
  *
- * @param vector<Boid*> boids
+ * @param SimParams params
  * @return Vec3d - a vector that when added to the boid's velocity makes their path a bit straighter
  *
  **/
-Vec3d Boid::straightenPath()
+Vec3d Boid::straightenPath(const SimParams& params)
 {
-	if(VAL(CIRCLE_PLANT))
+	if(params.circle_plant)
 	{
 		Vec3d velocity = this->getVelocity();
 		velocity.normalize(); 
-		velocity = velocity * VAL(FLOCK_SPEED)/10;
+		velocity = velocity * params.flock_speed/10;
 		return velocity;
 	}
 	else return Vec3d();
@@ -242,16 +636,19 @@ Vec3d Boid::straightenPath()
 /** @brief Boid::perch - Try and 'perch' our boid on the ground if they are close 
  *                       enough, and not already perching.
  *
- * @param vector<Boid*> boids
+ * With params.perch_on_plant, a boid flying into one of the plant's branches
+ * perches on it too, found with the plant's distance field.
+ *
+ * @param SimParams params
  *
  **/
-void Boid::perch()
+void Boid::perch(const SimParams& params)
 {
 	// check that user has perching enabled
-	if(VAL(CAN_PERCH))
+	if(params.can_perch)
 		{
 		// already perching, or too windy to perch
-		if(perching || wind_active)
+		if(this->isPerching() || wind_active)
 			return;
 
 		// start perching
@@ -260,8 +657,23 @@ void Boid::perch()
 		{
 			b_pos[1] = 0;
 			this->setPosition(b_pos);
-			perching = true;
-			this->m_perch_time = PERCH_TIME;
+			this->setPerching(true);
+			m_state->setPerchTimer(m_index, PERCH_TIME);
+			return;
+		}
+
+		// or perch on a branch it's flying into, sitting against it
+		if(params.perch_on_plant && params.plant_sdf)
+		{
+			double away[3];
+			double distance = params.plant_sdf->getDistance(b_pos, away);
+			Vec3d v = this->getVelocity();
+			if(distance <= BOID_SIZE && v[0] * away[0] + v[1] * away[1] + v[2] * away[2] < 0.0)
+			{
+				this->setPosition(b_pos + Vec3d(away[0], away[1], away[2]) * (BOID_SIZE - distance));
+				this->setPerching(true);
+				m_state->setPerchTimer(m_index, PERCH_TIME);
+			}
 		}
 	}
 }
@@ -271,10 +683,10 @@ void Boid::perch()
  * @return Vec3d - a wind vector if there is wind to be added, or a zero vector if not
  *
  **/
-Vec3d Boid::addWind()
+Vec3d Boid::addWind(const SimParams& params)
 {
 	Vec3d wind = Vec3d();
-	if(wind_active && VAL(ADD_WIND))
+	if(wind_active && params.add_wind)
 		wind = Vec3d(wind_speed,0,wind_speed);
 	return wind;
 }
@@ -282,14 +694,14 @@ Vec3d Boid::addWind()
 /** @brief handleWind - Simulate intermittent gusts of wind (if enabled)
  *
  **/
-void handleWind()
+void handleWind(const SimParams& params)
 {	
-	if(VAL(ADD_WIND))
+	if(params.add_wind)
 	{
 		// randomly create a gust every now and then
 		if(!wind_active)
 		{
-			if((rand() % 50) == 42)
+			if(wind_rng.nextInt(50) == 42)
 			{
 				wind_active = true;
 				wind_timer = WIND_TIME;
@@ -297,7 +709,7 @@ void handleWind()
 		}
 		// get a speed for the current gust
 		if(wind_active)
-			 wind_speed = getRandomSpeed(WIND_SPEED);
+			 wind_speed = getRandomSpeed(wind_rng, WIND_SPEED);
 
 		// turn the wind off if the timer reaches 0
 		if(!wind_timer )
@@ -309,21 +721,21 @@ void handleWind()
  *                               them change direction and velocity when they reach
  *                               a border
  *
- * @param vector<Boid*> boids
+ * @param SimParams params
  *
  **/
-void Boid::boundPosition() 
+void Boid::boundPosition(const SimParams& params) 
 {
 	double X_MIN, X_MAX, Y_MIN, Y_MAX, Z_MIN, Z_MAX, BOUNCE_V;
 	// the boundaries for each axis
-	X_MIN = -(VAL(FLOCK_RANGE));
-	X_MAX = VAL(FLOCK_RANGE);
+	X_MIN = -(params.flock_range);
+	X_MAX = params.flock_range;
 	Y_MIN = 0.0;
-	Y_MAX = VAL(FLOCK_RANGE);
-	Z_MIN = -(VAL(FLOCK_RANGE));
-	Z_MAX = VAL(FLOCK_RANGE);
+	Y_MAX = params.flock_range;
+	Z_MIN = -(params.flock_range);
+	Z_MAX = params.flock_range;
 	// the bounce velocity = user boids velocity setting
-	BOUNCE_V = VAL(FLOCK_SPEED);
+	BOUNCE_V = params.flock_speed;
 
 	Vec3d b_pos = this->getPosition();
 	Vec3d b_v = this->getVelocity();
@@ -340,58 +752,22 @@ void Boid::boundPosition()
 		b_v[2] = BOUNCE_V;
 	else if (b_pos[2] > Z_MAX)
 		b_v[2] = -BOUNCE_V;
-	m_velocity = b_v;
+	this->setVelocity(b_v);
 }
 
 /** @brief Boid::limitVelocity - Keep velocity within a certain limit
  *
- * @param vector<Boid*> boids
+ * @param SimParams params
  *
  **/
-void Boid::limitVelocity()
+void Boid::limitVelocity(const SimParams& params)
 {
-	double LIMIT = VAL(FLOCK_SPEED);
+	double LIMIT = params.flock_speed;
 	Vec3d b_v = this->getVelocity();
 	if(b_v.length() > LIMIT)
 	{
 	    b_v.normalize();
 		b_v = b_v * LIMIT;
-		m_velocity = b_v;
+		this->setVelocity(b_v);
 	}
-}
-
-/** @brief Boid::drawDirectionLine - Draw a red line indicating the current velocity
- *                                   vector for the direction the boid is moving in
- *
- * @param vector<Boid*> boids
- *
- **/
-void Boid::drawDirectionLine()
-{
-	Vec3d normal = m_velocity;
-	normal.normalize(); // get a unit vector
-	glPushMatrix();
-	    // scale so we start from the origin of the boid
-		glScaled(.1,.1,.1);
-		glBegin( GL_LINES );
-		// draw our red line
-		glVertex3d(normal[0]*3.5,normal[1]*3.5,normal[2]*3.5);
-		glVertex3d(normal[0],normal[1],normal[2]);
-		glEnd();
-	glPopMatrix();
-}
-
-/** @brief Boid::isNoticed - Check that the boid is within perception range
- *
- * @param Boid* b
- * @returns true if within perception range, false if not
- *
- **/
-bool Boid::isNoticed(Boid* b)
-{
-	Vec3d distance = (b->getPosition() - this->getPosition());
-	if(distance.length() > VAL(PERCEPTION))
-		return false;
-	else 
-		return true;
 }
\ No newline at end of file
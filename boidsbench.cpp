@@ -0,0 +1,1098 @@
+// boidsbench.cpp
+
+// Benchmarks for the boids simulation. This builds without FLTK or
+// OpenGL (see boidsbench.vcxproj) and just prints its results.
+//
+// usage: boidsbench scaling [boids] [steps] [max threads]
+//        - times moveBoids() with 1 up to max threads, and reports the
+//          speedup over running on a single thread
+//        boidsbench kernel [boids] [repeats]
+//        - times the scalar and AVX2 flocking kernels (see boidkernel.h) on
+//          every boid against every other boid, and checks they agree
+//        boidsbench clustered [boids] [steps]
+//        - lets the flock pack into a ring around the plant, then times a
+//          step from there with each neighbor search
+//        boidsbench nearest [boids] [k]
+//        - times a step flocking by perception and flocking with the k
+//          nearest boids, as the flock gets more crowded
+//        boidsbench farfield [boids] [perception]
+//        - times a step with a few far-field theta values (see
+//          SimParams::theta), and reports how far the boids' new velocities
+//          are from the exact ones
+//        boidsbench skin [boids] [steps]
+//        - times steps with a few neighbor list skins (see SimParams::skin),
+//          and counts how often the lists had to be remade
+//        boidsbench sort [boids] [steps]
+//        - times steps with the boids in the order they were made and sorted
+//          by position (see BoidSwarm::sortByPosition()), and on Linux counts
+//          the cache misses each one causes
+//        boidsbench spawn [boids] [churn] [frames]
+//        - each frame despawns churn random boids, spawns as many new ones and
+//          takes a step, timing the spawning separately, and checks that every
+//          handle still finds its boid, and that running it again with kept
+//          neighbor lists ends with the same flock
+//        boidsbench plant [boids] [max depth]
+//        - grows the modeler's plant to a few recursion depths, and times
+//          finding each boid's nearest branch with the plant's BVH (see
+//          plantbvh.h) against testing every branch, and a step with the
+//          boids steering around the plant
+//        boidsbench sdf [boids] [cell size]
+//        - makes the plant's distance field (see plantsdf.h) at a few
+//          recursion depths, and times looking up each boid's distance
+//          from the plant in it against finding it with the BVH, and how
+//          far apart the two are
+//        boidsbench record [boids] [frames]
+//        - times steps while recording them to a trajectory file (see
+//          trajectory.h) with floats and with 16 bit floats, then times
+//          reading the boids back from random frames, and how far they are
+//          from where they really were, and replaying them in slow motion
+//          (see replay.h)
+//        boidsbench suite [max boids] [output file]
+//        - times a step for flocks of 8 up to max boids (default 1M), spread
+//          out sparsely and densely, at a few perception distances, and
+//          writes the results as JSON (to the output file, or the screen)
+
+#include "boids.h"
+#include "boidkernel.h"
+#include "plantbvh.h"
+#include "plantsdf.h"
+#include "trajectory.h"
+#include "replay.h"
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/** @brief getTime - Get the current time in seconds
+ *
+ **/
+static double getTime()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** @brief timeSteps - Time a number of simulation steps on a fresh flock
+ *
+ * @param int num_boids - how many boids to simulate
+ * @param int steps - how many steps to time
+ * @param SimParams params - the settings to run with
+ * @return double - the average time per step, in seconds
+ *
+ **/
+static double timeSteps(int num_boids, int steps, const SimParams& params)
+{
+	BoidSwarm boids;
+	seedBoids(1);
+	initializeBoids(boids, num_boids);
+	// one untimed step so the threads and grid are warmed up
+	moveBoids(boids, params);
+
+	double start = getTime();
+	for(int i = 0; i < steps; i++)
+		moveBoids(boids, params);
+	return (getTime() - start) / steps;
+}
+
+/** @brief benchScaling - Report how moveBoids() speeds up with more threads
+ *
+ **/
+static void benchScaling(int num_boids, int steps, int max_threads)
+{
+	SimParams params;
+	printf("%d boids, %d steps\n", num_boids, steps);
+	printf("%8s %12s %10s\n", "threads", "ms/step", "speedup");
+
+	params.threads = 1;
+	double serial = timeSteps(num_boids, steps, params);
+	printf("%8d %12.3f %10.2f\n", 1, serial * 1000.0, 1.0);
+	for(int threads = 2; threads <= max_threads; threads++)
+	{
+		params.threads = threads;
+		double t = timeSteps(num_boids, steps, params);
+		printf("%8d %12.3f %10.2f\n", threads, t * 1000.0, serial / t);
+	}
+}
+
+/** @brief timeKernel - Time a flocking kernel on every boid in a state
+ *
+ * @param FlockKernel kernel - the kernel to time
+ * @param BoidState state - the boids to run it on
+ * @param vector<int> candidates - the neighbors every boid is tested against
+ * @param int repeats - how many times to run over the whole state
+ * @param vector<FlockSums> sums - set to each boid's results
+ * @return double - the average time per candidate tested, in seconds
+ *
+ **/
+static double timeKernel(FlockKernel kernel, const BoidState& state, const vector<int>& candidates,
+                         int repeats, vector<FlockSums>& sums)
+{
+	SimParams params;
+	double perception2 = params.perception * params.perception;
+	double flock_d2 = params.flock_d * params.flock_d;
+	int n = state.size();
+	sums.resize(n);
+
+	double start = getTime();
+	for(int r = 0; r < repeats; r++)
+		for(int i = 0; i < n; i++)
+			kernel(state, i, &candidates[0], n, perception2, flock_d2, sums[i]);
+	return (getTime() - start) / (double(repeats) * n * n);
+}
+
+/** @brief benchKernel - Compare the scalar and AVX2 flocking kernels
+ *
+ **/
+static void benchKernel(int num_boids, int repeats)
+{
+	BoidSwarm boids;
+	seedBoids(1);
+	initializeBoids(boids, num_boids);
+	const BoidState& state = boids.current();
+	// every boid is a candidate, as with the grid turned off
+	vector<int> candidates(num_boids);
+	for(int i = 0; i < num_boids; i++)
+		candidates[i] = i;
+
+	vector<FlockSums> scalar_sums, simd_sums;
+	double scalar = timeKernel(flockKernelScalar, state, candidates, repeats, scalar_sums);
+	printf("%d boids, %d repeats\n", num_boids, repeats);
+	printf("%8s %12s %10s\n", "kernel", "ns/pair", "speedup");
+	printf("%8s %12.3f %10.2f\n", "scalar", scalar * 1e9, 1.0);
+	if(!cpuHasAVX2())
+	{
+		printf("%8s %12s\n", "avx2", "n/a");
+		return;
+	}
+	double simd = timeKernel(flockKernelAVX2, state, candidates, repeats, simd_sums);
+	printf("%8s %12.3f %10.2f\n", "avx2", simd * 1e9, scalar / simd);
+
+	// the kernels add in different orders, so only expect rounding differences
+	double max_error = 0.0;
+	int count_mismatches = 0;
+	for(int i = 0; i < num_boids; i++)
+	{
+		if(scalar_sums[i].count != simd_sums[i].count)
+			count_mismatches++;
+		for(int k = 0; k < 3; k++)
+		{
+			max_error = max(max_error, fabs(scalar_sums[i].center[k] - simd_sums[i].center[k]));
+			max_error = max(max_error, fabs(scalar_sums[i].velocity[k] - simd_sums[i].velocity[k]));
+			max_error = max(max_error, fabs(scalar_sums[i].separation[k] - simd_sums[i].separation[k]));
+		}
+	}
+	printf("count mismatches: %d, largest difference: %g\n", count_mismatches, max_error);
+}
+
+/** @brief benchClustered - Compare the neighbor searches on a flock circling the plant
+ *
+ **/
+static void benchClustered(int num_boids, int steps)
+{
+	// how long the flock gets to settle into a ring around the plant
+	const int SETTLE_STEPS = 300;
+	const char* names[] = {"all", "grid", "octree"};
+
+	SimParams params;
+	params.circle_plant = true;
+	params.neighbor_search = SEARCH_OCTREE;
+	BoidSwarm settled;
+	seedBoids(1);
+	initializeBoids(settled, num_boids);
+	for(int i = 0; i < SETTLE_STEPS; i++)
+		moveBoids(settled, params);
+
+	printf("%d boids circling the plant, %d steps\n", num_boids, steps);
+	printf("%8s %12s %10s\n", "search", "ms/step", "speedup");
+	double brute_force = 0.0;
+	for(int search = SEARCH_ALL; search <= SEARCH_OCTREE; search++)
+	{
+		params.neighbor_search = search;
+		// every search starts from the same settled flock
+		BoidSwarm boids = settled;
+		double start = getTime();
+		for(int i = 0; i < steps; i++)
+			moveBoids(boids, params);
+		double t = (getTime() - start) / steps;
+		if(search == SEARCH_ALL)
+			brute_force = t;
+		printf("%8s %12.3f %10.2f\n", names[search], t * 1000.0, brute_force / t);
+	}
+}
+
+// what the suite runs through
+static const int SUITE_SIZES[] = {8, 64, 512, 4096, 32768, 262144, 1048576};
+static const double SUITE_PERCEPTIONS[] = {0.75, 1.35, 2.5};
+struct SuiteLayout
+{
+	const char* name;
+	double density;  // boids per unit of volume
+};
+static const SuiteLayout SUITE_LAYOUTS[] = {{"sparse", 0.5}, {"dense", 8.0}};
+// keep timing each case until this many seconds have gone by
+const double SUITE_MIN_TIME = 0.25;
+const int SUITE_MAX_STEPS = 1000;
+
+/** @brief makeLayout - Fill a swarm with boids spread evenly through a cube
+ *
+ * @param BoidSwarm boids - the swarm to fill
+ * @param int num_boids - how many boids to add
+ * @param double range - the cube goes from -range to range on each axis
+ *
+ **/
+static void makeLayout(BoidSwarm& boids, int num_boids, double range)
+{
+	RandomStream rng(1, STREAM_INIT);
+	seedBoids(1);
+	boids.clear();
+	for(int i = 0; i < num_boids; i++)
+	{
+		double x = (rng.nextDouble() * 2.0 - 1.0) * range;
+		double y = (rng.nextDouble() * 2.0 - 1.0) * range;
+		double z = (rng.nextDouble() * 2.0 - 1.0) * range;
+		boids.spawnBoid(Vec3d(x, y, z), getRandomVelocityVector(rng));
+	}
+}
+
+/** @brief benchNearest - Compare flocking by perception with flocking with the k
+ *                        nearest boids, as the flock gets more crowded
+ *
+ **/
+static void benchNearest(int num_boids, int k)
+{
+	const double densities[] = {0.5, 2.0, 8.0, 32.0};
+	const int STEPS = 5;
+
+	printf("%d boids, k = %d\n", num_boids, k);
+	printf("%10s %16s %16s\n", "density", "perception ms", "nearest ms");
+	for(int d = 0; d < int(sizeof(densities) / sizeof(densities[0])); d++)
+	{
+		SimParams params;
+		params.flock_range = pow(num_boids / densities[d], 1.0 / 3.0) / 2.0;
+		double times[2];
+		for(int mode = 0; mode < 2; mode++)
+		{
+			params.nearest = (mode == 0) ? 0 : k;
+			BoidSwarm boids;
+			makeLayout(boids, num_boids, params.flock_range);
+			moveBoids(boids, params);
+			double start = getTime();
+			for(int i = 0; i < STEPS; i++)
+				moveBoids(boids, params);
+			times[mode] = (getTime() - start) / STEPS;
+		}
+		printf("%10g %16.3f %16.3f\n", densities[d], times[0] * 1000.0, times[1] * 1000.0);
+	}
+}
+
+/** @brief benchFarField - Time a step at a few far-field theta values, and measure
+ *                         how much each one changes the boids' new velocities
+ *
+ * @param int num_boids - how many boids to flock
+ * @param double perception - how far away a boid can notice other boids
+ *
+ **/
+static void benchFarField(int num_boids, double perception)
+{
+	const double thetas[] = {0.0, 0.25, 0.5, 0.75, 1.0};
+	const double DENSITY = 8.0;
+	const int STEPS = 5;
+
+	SimParams params;
+	params.perception = perception;
+	params.flock_range = pow(num_boids / DENSITY, 1.0 / 3.0) / 2.0;
+	BoidSwarm start;
+	makeLayout(start, num_boids, params.flock_range);
+
+	// the exact step, to measure the others against
+	BoidSwarm exact = start;
+	moveBoids(exact, params);
+
+	printf("%d boids, perception %g\n", num_boids, perception);
+	printf("%8s %10s %16s %16s\n", "theta", "ms", "mean error %", "max error %");
+	for(int t = 0; t < int(sizeof(thetas) / sizeof(thetas[0])); t++)
+	{
+		params.theta = thetas[t];
+		double elapsed = 0.0;
+		BoidSwarm boids;
+		for(int i = 0; i < STEPS; i++)
+		{
+			boids = start;
+			double begin = getTime();
+			moveBoids(boids, params);
+			elapsed += getTime() - begin;
+		}
+
+		double total_error = 0.0;
+		double max_error = 0.0;
+		for(int i = 0; i < num_boids; i++)
+		{
+			Vec3d want = exact.getVelocity(i);
+			double error = (boids.getVelocity(i) - want).length() / max(want.length(), 1e-12);
+			total_error += error;
+			max_error = max(max_error, error);
+		}
+		printf("%8g %10.3f %16.4f %16.4f\n", thetas[t], elapsed / STEPS * 1000.0,
+		       total_error / max(num_boids, 1) * 100.0, max_error * 100.0);
+	}
+}
+
+/** @brief benchSkin - Time steps keeping the neighbor lists with a few skins, and
+ *                     count how often each one had to remake them
+ *
+ * @param int num_boids - how many boids to flock
+ * @param int steps - how many steps to time with each skin
+ *
+ **/
+static void benchSkin(int num_boids, int steps)
+{
+	const double skins[] = {0.0, 0.25, 0.5, 0.75, 1.0, 1.5};
+	const double DENSITY = 2.0;
+
+	SimParams params;
+	params.flock_range = pow(num_boids / DENSITY, 1.0 / 3.0) / 2.0;
+	BoidSwarm start;
+	makeLayout(start, num_boids, params.flock_range);
+
+	printf("%d boids, %d steps\n", num_boids, steps);
+	printf("%8s %12s %10s %10s\n", "skin", "ms/step", "rebuilds", "speedup");
+	double no_skin = 0.0;
+	for(int s = 0; s < int(sizeof(skins) / sizeof(skins[0])); s++)
+	{
+		params.skin = skins[s];
+		BoidSwarm boids = start;
+		seedBoids(1);
+		double begin = getTime();
+		for(int i = 0; i < steps; i++)
+			moveBoids(boids, params);
+		double t = (getTime() - begin) / steps;
+		long long list_steps, list_rebuilds;
+		getNeighborListCounts(list_steps, list_rebuilds);
+		if(s == 0)
+			no_skin = t;
+		printf("%8g %12.3f %10lld %10.2f\n", skins[s], t * 1000.0, list_rebuilds, no_skin / t);
+	}
+}
+
+/** @brief CacheMissCounter - Counts the processor's cache misses between start() and
+ *                            stop(), using the Linux performance counters. Elsewhere,
+ *                            or where the counters aren't allowed, it counts nothing.
+ *
+ **/
+class CacheMissCounter
+{
+public:
+	CacheMissCounter() : m_fd(-1)
+	{
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		// count the whole process, so the worker threads are included
+		attr.inherit = 1;
+		m_fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+	}
+	~CacheMissCounter()
+	{
+#ifdef __linux__
+		if(m_fd >= 0)
+			close(m_fd);
+#endif
+	}
+
+	bool isAvailable() const {return m_fd >= 0;}
+
+	void start()
+	{
+#ifdef __linux__
+		if(m_fd < 0)
+			return;
+		ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+
+	long long stop()
+	{
+		long long count = 0;
+#ifdef __linux__
+		if(m_fd < 0)
+			return 0;
+		ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if(read(m_fd, &count, sizeof(count)) != sizeof(count))
+			count = 0;
+#endif
+		return count;
+	}
+
+private:
+	int m_fd;
+};
+
+/** @brief benchSort - Compare steps with the boids in the order they were made and
+ *                     with them sorted by position
+ *
+ * @param int num_boids - how many boids to flock
+ * @param int steps - how many steps to time each way
+ *
+ **/
+static void benchSort(int num_boids, int steps)
+{
+	const int SORT_INTERVAL = 20;
+	const double DENSITY = 2.0;
+	const char* names[] = {"unsorted", "sorted"};
+
+	SimParams params;
+	params.flock_range = pow(num_boids / DENSITY, 1.0 / 3.0) / 2.0;
+	BoidSwarm start;
+	makeLayout(start, num_boids, params.flock_range);
+	CacheMissCounter misses;
+
+	printf("%d boids, %d steps, sorted every %d steps\n", num_boids, steps, SORT_INTERVAL);
+	printf("%10s %12s %22s\n", "order", "ms/step", "cache misses/step");
+	for(int sorted = 0; sorted < 2; sorted++)
+	{
+		params.sort_interval = sorted ? SORT_INTERVAL : 0;
+		BoidSwarm boids = start;
+		seedBoids(1);
+		double begin = getTime();
+		misses.start();
+		for(int i = 0; i < steps; i++)
+			moveBoids(boids, params);
+		long long count = misses.stop();
+		double t = (getTime() - begin) / steps;
+		if(misses.isAvailable())
+			printf("%10s %12.3f %22lld\n", names[sorted], t * 1000.0, count / steps);
+		else
+			printf("%10s %12.3f %22s\n", names[sorted], t * 1000.0, "n/a");
+	}
+}
+
+/** @brief runChurn - Despawn and spawn lots of boids every frame, moving the flock
+ *                    in between
+ *
+ * @param int num_boids - how many boids the flock keeps
+ * @param int churn - how many boids to replace each frame
+ * @param int frames - how many frames to run
+ * @param double skin - the neighbor list skin to move the flock with
+ * @param double spawn_time - set to the seconds spent despawning and spawning
+ * @param double step_time - set to the seconds spent moving the flock
+ * @param int lost - set to how many times a handle didn't find its boid
+ * @return unsigned long long - the hash of the flock at the end
+ *
+ **/
+static unsigned long long runChurn(int num_boids, int churn, int frames, double skin,
+                                   double& spawn_time, double& step_time, int& lost)
+{
+	const double DENSITY = 2.0;
+
+	SimParams params;
+	params.flock_range = pow(num_boids / DENSITY, 1.0 / 3.0) / 2.0;
+	params.skin = skin;
+	// the AVX2 kernel's sums round differently with the extra boids on a list
+	params.simd = false;
+	BoidSwarm boids;
+	seedBoids(1);
+	makeLayout(boids, num_boids, params.flock_range);
+	RandomStream rng(2, 0);
+
+	// a handle to every boid, in no particular order
+	vector<BoidHandle> handles;
+	for(int i = 0; i < boids.size(); i++)
+		handles.push_back(boids.getHandle(i));
+
+	spawn_time = 0.0;
+	step_time = 0.0;
+	lost = 0;
+	for(int f = 0; f < frames; f++)
+	{
+		double begin = getTime();
+		for(int k = 0; k < churn && !handles.empty(); k++)
+		{
+			int h = rng.nextInt(int(handles.size()));
+			boids.despawnBoid(handles[h]);
+			handles[h] = handles.back();
+			handles.pop_back();
+		}
+		for(int k = 0; k < churn; k++)
+		{
+			Vec3d pos((rng.nextDouble() * 2.0 - 1.0) * params.flock_range,
+			          (rng.nextDouble() * 2.0 - 1.0) * params.flock_range,
+			          (rng.nextDouble() * 2.0 - 1.0) * params.flock_range);
+			handles.push_back(boids.spawnBoid(pos, getRandomVelocityVector(rng)));
+		}
+		double middle = getTime();
+		moveBoids(boids, params);
+		double end = getTime();
+		spawn_time += middle - begin;
+		step_time += end - middle;
+
+		for(int h = 0; h < int(handles.size()); h++)
+		{
+			int i = boids.findBoid(handles[h]);
+			if(i < 0 || boids.getHandle(i).slot != handles[h].slot)
+				lost++;
+		}
+	}
+	return boids.hash();
+}
+
+/** @brief benchSpawn - Time despawning and spawning lots of boids every frame, and
+ *                      check the handles to the surviving boids keep working
+ *
+ * The same churn is run again with neighbor lists kept between steps, which
+ * have to notice the boids being renumbered and end with the same flock.
+ *
+ * @param int num_boids - how many boids the flock keeps
+ * @param int churn - how many boids to replace each frame
+ * @param int frames - how many frames to run
+ *
+ **/
+static void benchSpawn(int num_boids, int churn, int frames)
+{
+	const double SKIN = 1.0;
+
+	double spawn_time, step_time;
+	int lost;
+	unsigned long long hash = runChurn(num_boids, churn, frames, 0.0, spawn_time, step_time, lost);
+	printf("%d boids, replacing %d each frame for %d frames\n", num_boids, churn, frames);
+	printf("spawn + despawn: %.3f ms/frame (%.1f ns per boid)\n", spawn_time / frames * 1000.0,
+	       spawn_time / (double(frames) * max(churn, 1) * 2.0) * 1e9);
+	printf("step: %.3f ms/frame\n", step_time / frames * 1000.0);
+	printf("handles that lost their boid: %d\n", lost);
+
+	double skin_spawn_time, skin_step_time;
+	int skin_lost;
+	unsigned long long skin_hash = runChurn(num_boids, churn, frames, SKIN, skin_spawn_time, skin_step_time,
+	                                        skin_lost);
+	long long list_steps, list_rebuilds;
+	getNeighborListCounts(list_steps, list_rebuilds);
+	printf("step with skin %g: %.3f ms/frame, lists remade %lld of %lld steps\n", SKIN,
+	       skin_step_time / frames * 1000.0, list_rebuilds, list_steps);
+	printf("hash: %016llx, with skin %g: %016llx (%s)\n", hash, SKIN, skin_hash,
+	       (hash == skin_hash) ? "same" : "DIFFERENT");
+}
+
+/** @brief growPlant - Make the modeler's plant with its default controls, the way
+ *                     SampleModel::draw() draws it
+ *
+ * @param PlantTurtle turtle - set to the plant's branches and leaves
+ * @param int depth - the recursion depth of the grammar
+ *
+ **/
+static void growPlant(PlantTurtle& turtle, int depth)
+{
+	const double HEIGHT = 0.2, WIDTH = 0.05, LEAF_SIZE = 0.1;
+	const double ANGLE = 45.0, BEND_ANGLE = -57.0;
+
+	// the grammar, as in SampleModel::generateGrammar()
+	string rules = "0";
+	for(int d = 0; d < depth; d++)
+	{
+		string next;
+		for(size_t i = 0; i < rules.length(); i++)
+		{
+			switch(rules[i])
+			{
+				case '0': next.append("1[0]1[0]0"); break;
+				case '1': next.append("11"); break;
+				default: next.push_back(rules[i]); break;
+			}
+		}
+		rules = next;
+	}
+
+	turtle.reset();
+	turtle.rotate(-90, 1.0, 0.0, 0.0);
+	for(size_t i = 0; i < rules.length(); i++)
+	{
+		switch(rules[i])
+		{
+			case '0':
+				turtle.addCylinder(HEIGHT, WIDTH);
+				turtle.translate(0, 0, HEIGHT);
+				turtle.addSphere(LEAF_SIZE);
+				break;
+			case '1':
+				turtle.addCylinder(HEIGHT, WIDTH);
+				turtle.translate(0, 0, HEIGHT);
+				break;
+			case '[':
+				turtle.pushMatrix();
+				turtle.rotate(BEND_ANGLE, 0.0, 1.0, 0.0);
+				turtle.rotate(ANGLE, 1.0, 0.0, 1.0);
+				break;
+			case ']':
+				turtle.popMatrix();
+				turtle.rotate(BEND_ANGLE, 0.0, 1.0, 0.0);
+				turtle.rotate(-BEND_ANGLE, 0.0, 1.0, 0.0);
+				turtle.rotate(-ANGLE, 1.0, 0.0, 1.0);
+				break;
+			default: break;
+		}
+	}
+}
+
+/** @brief benchPlant - Time finding the boids' nearest branches with the plant's BVH
+ *                      and by testing every branch, for bigger and bigger plants
+ *
+ * @param int num_boids - how many boids to look up
+ * @param int max_depth - the deepest plant to grow
+ *
+ **/
+static void benchPlant(int num_boids, int max_depth)
+{
+	const double AVOID_DISTANCE = 0.5;
+
+	SimParams params;
+	params.plant_avoid_d = AVOID_DISTANCE;
+	BoidSwarm boids;
+	seedBoids(1);
+	initializeBoids(boids, num_boids);
+
+	printf("%6s %9s %12s %12s %9s %12s %11s\n", "depth", "capsules", "bvh ns", "all ns", "speedup",
+	       "step ms", "mismatches");
+	for(int depth = 1; depth <= max_depth; depth++)
+	{
+		PlantTurtle turtle;
+		growPlant(turtle, depth);
+		PlantBVH bvh;
+		bvh.build(turtle.getCapsules());
+		const vector<PlantCapsule>& capsules = bvh.getCapsules();
+
+		// the nearest branch of each boid, both ways
+		vector<double> found(boids.size());
+		double begin = getTime();
+		for(int i = 0; i < boids.size(); i++)
+		{
+			PlantHit hit;
+			found[i] = bvh.findNearest(boids.getPosition(i), AVOID_DISTANCE, hit) ? hit.distance : HUGE_VAL;
+		}
+		double bvh_time = getTime() - begin;
+
+		int mismatches = 0;
+		begin = getTime();
+		for(int i = 0; i < boids.size(); i++)
+		{
+			double nearest = HUGE_VAL;
+			for(size_t c = 0; c < capsules.size(); c++)
+			{
+				double away[3];
+				double distance = getCapsuleDistance(capsules[c], boids.getPosition(i), away);
+				if(distance <= AVOID_DISTANCE)
+					nearest = min(nearest, distance);
+			}
+			if(nearest != found[i])
+				mismatches++;
+		}
+		double all_time = getTime() - begin;
+
+		// and a step with the boids steering around it
+		BoidSwarm flock = boids;
+		params.plant = &bvh;
+		begin = getTime();
+		moveBoids(flock, params);
+		double step_time = getTime() - begin;
+
+		printf("%6d %9d %12.1f %12.1f %8.1fx %12.3f %11d\n", depth, int(capsules.size()),
+		       bvh_time / boids.size() * 1e9, all_time / boids.size() * 1e9,
+		       (bvh_time > 0.0) ? all_time / bvh_time : 0.0, step_time * 1000.0, mismatches);
+	}
+}
+
+/** @brief benchSDF - Time making the plant's distance field, and looking up the boids'
+ *                    distances from the plant in it and with the BVH
+ *
+ * @param int num_boids - how many boids to look up
+ * @param double cell_size - the distance between the field's voxels
+ *
+ **/
+static void benchSDF(int num_boids, double cell_size)
+{
+	const double MAX_DISTANCE = 1.0;
+
+	// the boids spread through the plant's bounds (the plant grows up from the origin)
+	BoidSwarm boids;
+	seedBoids(1);
+	initializeBoids(boids, num_boids);
+
+	printf("%6s %9s %10s %10s %10s %10s %11s %11s\n", "depth", "capsules", "voxels", "build ms",
+	       "sdf ns", "bvh ns", "mean error", "max error");
+	for(int depth = 1; depth <= 6; depth++)
+	{
+		PlantTurtle turtle;
+		growPlant(turtle, depth);
+		PlantBVH bvh;
+		bvh.build(turtle.getCapsules());
+
+		PlantSDF sdf;
+		double begin = getTime();
+		sdf.build(bvh, cell_size, MAX_DISTANCE);
+		double build_time = getTime() - begin;
+
+		vector<double> sdf_distances(boids.size());
+		double gradient[3];
+		begin = getTime();
+		for(int i = 0; i < boids.size(); i++)
+			sdf_distances[i] = sdf.getDistance(boids.getPosition(i), gradient);
+		double sdf_time = getTime() - begin;
+
+		vector<double> bvh_distances(boids.size());
+		begin = getTime();
+		for(int i = 0; i < boids.size(); i++)
+		{
+			PlantHit hit;
+			bvh_distances[i] = bvh.findNearest(boids.getPosition(i), MAX_DISTANCE, hit) ? hit.distance : MAX_DISTANCE;
+		}
+		double bvh_time = getTime() - begin;
+
+		// only the boids near the plant have anything to compare
+		double total_error = 0.0, max_error = 0.0;
+		int near = 0;
+		for(int i = 0; i < boids.size(); i++)
+		{
+			if(bvh_distances[i] >= MAX_DISTANCE)
+				continue;
+			double error = fabs(sdf_distances[i] - bvh_distances[i]);
+			total_error += error;
+			max_error = max(max_error, error);
+			near++;
+		}
+
+		printf("%6d %9d %10d %10.2f %10.1f %10.1f %11.4f %11.4f\n", depth, bvh.getCapsuleCount(),
+		       sdf.getVoxelCount(), build_time * 1000.0, sdf_time / boids.size() * 1e9,
+		       bvh_time / boids.size() * 1e9, near ? total_error / near : 0.0, max_error);
+	}
+}
+
+/** @brief benchRecord - Report what recording a trajectory adds to a step, how big
+ *                       the file is, and how fast frames can be read back from it
+ *                       and replayed
+ *
+ * @param int num_boids - how many boids to record
+ * @param int frames - how many steps to record
+ *
+ **/
+static void benchRecord(int num_boids, int frames)
+{
+	const char* PATH = "boidsbench.traj";
+	SimParams params;
+
+	printf("%-8s %10s %10s %12s %11s %11s %11s %11s\n", "format", "step ms", "close ms", "bytes/frame",
+	       "read ns", "replay ns", "max error", "file frames");
+	for(int half = -1; half <= 1; half++)
+	{
+		BoidSwarm boids;
+		seedBoids(1);
+		initializeBoids(boids, num_boids);
+		moveBoids(boids, params);
+
+		// a run with no recording, to compare against
+		TrajectoryRecorder recorder;
+		if(half >= 0 && !recorder.open(PATH, half != 0))
+		{
+			fprintf(stderr, "couldn't open %s\n", PATH);
+			return;
+		}
+		double start = getTime();
+		for(int f = 0; f < frames; f++)
+		{
+			moveBoids(boids, params);
+			recorder.record(boids.current());
+		}
+		double step_time = (getTime() - start) / frames;
+		start = getTime();
+		bool written = recorder.close();
+		double close_time = getTime() - start;
+		if(half < 0)
+		{
+			printf("%-8s %10.3f\n", "none", step_time * 1000.0);
+			continue;
+		}
+		if(!written)
+		{
+			fprintf(stderr, "couldn't write %s\n", PATH);
+			return;
+		}
+
+		TrajectoryReader reader;
+		if(!reader.open(PATH))
+		{
+			fprintf(stderr, "couldn't read %s\n", PATH);
+			return;
+		}
+		FILE* file = fopen(PATH, "rb");
+		if(!file)
+		{
+			fprintf(stderr, "couldn't open %s\n", PATH);
+			return;
+		}
+		fseek(file, 0, SEEK_END);
+		long long file_size = ftell(file);
+		fclose(file);
+
+		// read every boid from frames picked at random
+		RandomStream rng(1, 0);
+		int reads = 0;
+		start = getTime();
+		Vec3d read;
+		for(int r = 0; r < 20; r++)
+		{
+			int frame = rng.nextInt(reader.getFrameCount());
+			for(int i = 0; i < reader.getBoidCount(frame); i++)
+				read = reader.getPosition(frame, i);
+			reads += reader.getBoidCount(frame);
+		}
+		double read_time = (getTime() - start) / max(reads, 1);
+
+		// the last frame is the boids as they are now
+		double max_error = 0.0;
+		int last = reader.getFrameCount() - 1;
+		for(int i = 0; i < boids.size(); i++)
+		{
+			Vec3d pos = boids.getPosition(i);
+			Vec3d recorded = reader.getPosition(last, i);
+			for(int k = 0; k < 3; k++)
+				max_error = max(max_error, fabs(recorded[k] - pos[k]));
+		}
+		int frame_count = reader.getFrameCount();
+		reader.close();
+
+		// half a frame at a time, so every other draw has to blend two frames
+		TrajectoryReplay replay;
+		replay.open(PATH);
+		int replayed = 0;
+		start = getTime();
+		for(int r = 0; r < 20; r++)
+		{
+			replay.advance(0.5);
+			replayed += replay.size();
+		}
+		double replay_time = (getTime() - start) / max(replayed, 1);
+		replay.close();
+		remove(PATH);
+
+		printf("%-8s %10.3f %10.3f %12lld %11.1f %11.1f %11.6f %11d\n", half ? "half" : "float",
+		       step_time * 1000.0, close_time * 1000.0, file_size / frames, read_time * 1e9,
+		       replay_time * 1e9, max_error, frame_count);
+	}
+}
+
+/** @brief benchSuite - Time a step across flock sizes, densities and perception
+ *                      distances, and write the results as JSON
+ *
+ * @param int max_boids - the largest flock to time
+ * @param FILE out - where to write the JSON
+ *
+ **/
+static void benchSuite(int max_boids, FILE* out)
+{
+	SimParams params;
+	fprintf(out, "{\n");
+	fprintf(out, "  \"threads\": %d,\n", params.threads);
+	fprintf(out, "  \"neighbor_search\": %d,\n", params.neighbor_search);
+	fprintf(out, "  \"simd\": %s,\n", (params.simd && cpuHasAVX2()) ? "true" : "false");
+	fprintf(out, "  \"results\": [");
+
+	bool first = true;
+	for(int s = 0; s < int(sizeof(SUITE_SIZES) / sizeof(SUITE_SIZES[0])); s++)
+	{
+		int num_boids = SUITE_SIZES[s];
+		if(num_boids > max_boids)
+			break;
+		for(int l = 0; l < int(sizeof(SUITE_LAYOUTS) / sizeof(SUITE_LAYOUTS[0])); l++)
+		{
+			const SuiteLayout& layout = SUITE_LAYOUTS[l];
+			// size the cube for the density, and keep the boids inside it
+			double range = pow(num_boids / layout.density, 1.0 / 3.0) / 2.0;
+			params.flock_range = range;
+
+			for(int p = 0; p < int(sizeof(SUITE_PERCEPTIONS) / sizeof(SUITE_PERCEPTIONS[0])); p++)
+			{
+				params.perception = SUITE_PERCEPTIONS[p];
+				fprintf(stderr, "%d boids, %s, perception %g\n", num_boids, layout.name, params.perception);
+
+				BoidSwarm boids;
+				makeLayout(boids, num_boids, range);
+				moveBoids(boids, params);
+
+				int steps = 0;
+				double start = getTime();
+				double elapsed = 0.0;
+				do {
+					moveBoids(boids, params);
+					steps++;
+					elapsed = getTime() - start;
+				} while(elapsed < SUITE_MIN_TIME && steps < SUITE_MAX_STEPS);
+				double step_time = elapsed / steps;
+
+				fprintf(out, "%s\n    {\"boids\": %d, \"layout\": \"%s\", \"density\": %g, "
+				        "\"perception\": %g, \"steps\": %d, \"ms_per_step\": %.4f, "
+				        "\"boid_steps_per_second\": %.0f}",
+				        first ? "" : ",", num_boids, layout.name, layout.density,
+				        params.perception, steps, step_time * 1000.0, num_boids / step_time);
+				first = false;
+			}
+		}
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* mode = (argc > 1) ? argv[1] : "scaling";
+
+	if(strcmp(mode, "scaling") == 0)
+	{
+		int max_threads = int(thread::hardware_concurrency());
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 20000;
+		int steps = (argc > 3) ? atoi(argv[3]) : 20;
+		if(argc > 4)
+			max_threads = atoi(argv[4]);
+		if(max_threads < 1)
+			max_threads = 1;
+		benchScaling(num_boids, steps, max_threads);
+		return 0;
+	}
+
+	if(strcmp(mode, "kernel") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 2000;
+		int repeats = (argc > 3) ? atoi(argv[3]) : 20;
+		if(num_boids < 1)
+			num_boids = 1;
+		benchKernel(num_boids, repeats);
+		return 0;
+	}
+
+	if(strcmp(mode, "clustered") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 5000;
+		int steps = (argc > 3) ? atoi(argv[3]) : 10;
+		if(steps < 1)
+			steps = 1;
+		benchClustered(num_boids, steps);
+		return 0;
+	}
+
+	if(strcmp(mode, "nearest") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 20000;
+		int k = (argc > 3) ? atoi(argv[3]) : 7;
+		benchNearest(num_boids, k);
+		return 0;
+	}
+
+	if(strcmp(mode, "farfield") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 20000;
+		double perception = (argc > 3) ? atof(argv[3]) : 3.0;
+		benchFarField(num_boids, perception);
+		return 0;
+	}
+
+	if(strcmp(mode, "skin") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 20000;
+		int steps = (argc > 3) ? atoi(argv[3]) : 50;
+		if(steps < 1)
+			steps = 1;
+		benchSkin(num_boids, steps);
+		return 0;
+	}
+
+	if(strcmp(mode, "sort") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 200000;
+		int steps = (argc > 3) ? atoi(argv[3]) : 20;
+		if(steps < 1)
+			steps = 1;
+		benchSort(num_boids, steps);
+		return 0;
+	}
+
+	if(strcmp(mode, "spawn") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 100000;
+		int churn = (argc > 3) ? atoi(argv[3]) : 5000;
+		int frames = (argc > 4) ? atoi(argv[4]) : 10;
+		if(frames < 1)
+			frames = 1;
+		benchSpawn(num_boids, churn, frames);
+		return 0;
+	}
+
+	if(strcmp(mode, "plant") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 20000;
+		int max_depth = (argc > 3) ? atoi(argv[3]) : 7;
+		benchPlant(num_boids, max_depth);
+		return 0;
+	}
+
+	if(strcmp(mode, "sdf") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 200000;
+		double cell_size = (argc > 3) ? atof(argv[3]) : 0.05;
+		benchSDF(num_boids, cell_size);
+		return 0;
+	}
+
+	if(strcmp(mode, "record") == 0)
+	{
+		int num_boids = (argc > 2) ? atoi(argv[2]) : 100000;
+		int frames = (argc > 3) ? atoi(argv[3]) : 50;
+		if(frames < 1)
+			frames = 1;
+		benchRecord(num_boids, frames);
+		return 0;
+	}
+
+	if(strcmp(mode, "suite") == 0)
+	{
+		int max_boids = (argc > 2) ? atoi(argv[2]) : 1048576;
+		FILE* out = stdout;
+		if(argc > 3)
+		{
+			out = fopen(argv[3], "w");
+			if(!out)
+			{
+				fprintf(stderr, "couldn't open %s\n", argv[3]);
+				return 1;
+			}
+		}
+		benchSuite(max_boids, out);
+		if(out != stdout)
+			fclose(out);
+		return 0;
+	}
+
+	fprintf(stderr, "usage: boidsbench scaling [boids] [steps] [max threads]\n"
+	                "       boidsbench kernel [boids] [repeats]\n"
+	                "       boidsbench clustered [boids] [steps]\n"
+	                "       boidsbench nearest [boids] [k]\n"
+	                "       boidsbench farfield [boids] [perception]\n"
+	                "       boidsbench skin [boids] [steps]\n"
+	                "       boidsbench sort [boids] [steps]\n"
+	                "       boidsbench spawn [boids] [churn] [frames]\n"
+	                "       boidsbench plant [boids] [max depth]\n"
+	                "       boidsbench sdf [boids] [cell size]\n"
+	                "       boidsbench record [boids] [frames]\n"
+	                "       boidsbench suite [max boids] [output file]\n");
+	return 1;
+}
@@ -0,0 +1,86 @@
+#include "boidsdraw.h"
+#include "modelerapp.h"
+
+/** @brief drawDirectionLine - Draw a red line indicating the current velocity
+ *                              vector for the direction the boid is moving in
+ *
+ * @param Vec3d velocity - the boid's velocity
+ *
+ **/
+static void drawDirectionLine(Vec3d velocity)
+{
+	Vec3d normal = velocity;
+	normal.normalize(); // get a unit vector
+	glPushMatrix();
+	    // scale so we start from the origin of the boid
+		glScaled(.1,.1,.1);
+		glBegin( GL_LINES );
+		// draw our red line
+		glVertex3d(normal[0]*3.5,normal[1]*3.5,normal[2]*3.5);
+		glVertex3d(normal[0],normal[1],normal[2]);
+		glEnd();
+	glPopMatrix();
+}
+
+/** @brief drawBoid - Draw a single boid
+ *
+ * @param Vec3d pos - where the boid is
+ * @param Vec3d velocity - the boid's velocity, for its direction line
+ * @param int color - the boid's color setting
+ * @param bool show_dir - whether to draw the direction line
+ *
+ **/
+static void drawBoid(const Vec3d& pos, const Vec3d& velocity, int color, bool show_dir)
+{
+	glPushMatrix();
+		glTranslated(pos[0], pos[1], pos[2]);
+		drawSphere(BOID_SIZE);	
+		// show direction of velocity with a line, if setting is on
+		if(show_dir)
+		{
+			setDiffuseColor(COLOR_RED);
+			drawDirectionLine(velocity);
+			setColor(color);
+		}
+	glPopMatrix();
+}
+
+/** @brief drawBoids - Draw all of our boids in the sample model space
+ *
+ * Each species is drawn in the next color after the one before it.
+ *
+ * @param BoidSwarm boids
+ *
+ **/
+void drawBoids(const BoidSwarm& boids) 
+{
+	int boid_color = int (VAL(BOID_COLOR) + 0.5);
+	bool show_dir = (VAL(SHOW_DIR) != 0);
+	for(int i = 0; i < boids.size(); i++)
+	{
+		// the boids of a species are together, so the color only changes
+		// at the start of each species
+		int color = (boid_color - 1 + boids.getSpecies(i)) % 16 + 1;
+		if(i == 0 || boids.getSpecies(i) != boids.getSpecies(i - 1))
+			setColor(color);
+		drawBoid(boids.getPosition(i), boids.getVelocity(i), color, show_dir);
+	}
+}
+
+/** @brief drawBoids - Draw the boids of a replay, as they are at its current time
+ *
+ * @param TrajectoryReplay replay
+ *
+ **/
+void drawBoids(const TrajectoryReplay& replay)
+{
+	int boid_color = int (VAL(BOID_COLOR) + 0.5);
+	bool show_dir = (VAL(SHOW_DIR) != 0);
+	for(int i = 0; i < replay.size(); i++)
+	{
+		int color = (boid_color - 1 + replay.getSpecies(i)) % 16 + 1;
+		if(i == 0 || replay.getSpecies(i) != replay.getSpecies(i - 1))
+			setColor(color);
+		drawBoid(replay.getPosition(i), replay.getVelocity(i), color, show_dir);
+	}
+}
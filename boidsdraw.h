@@ -0,0 +1,46 @@
+// boidsdraw.h
+
+// Drawing for the boids. This is kept apart from the simulation in
+// boids.h so the simulation can be built without FLTK or OpenGL.
+
+#ifndef BOIDSDRAW_H
+#define BOIDSDRAW_H
+
+#include "modelerdraw.h"
+#include "boids.h"
+#include "replay.h"
+
+// these are defined in boidsdraw.cpp
+extern void drawBoids(const BoidSwarm&);
+extern void drawBoids(const TrajectoryReplay&);
+
+/** @brief setColor - Set the diffuse color of subsequently drawn models
+ *
+ * @param int color - the color setting from the control value
+ *
+ **/
+static void setColor(int color)
+{
+	switch(color)
+	{
+		case 1: setDiffuseColor(COLOR_TURQUOISE); break;
+		case 2: setDiffuseColor(COLOR_ROYAL_BLUE); break;
+		case 3: setDiffuseColor(COLOR_MIDNIGHT_BLUE); break;
+		case 4: setDiffuseColor(COLOR_OLIVE); break;
+		case 5: setDiffuseColor(COLOR_PLUM); break;
+		case 6: setDiffuseColor(COLOR_FOREST_GREEN); break;
+		case 7: setDiffuseColor(COLOR_LAVENDER); break;
+		case 8: setDiffuseColor(COLOR_GOLDENROD); break;
+		case 9: setDiffuseColor(COLOR_WHITE_ROSE); break;
+		case 10: setDiffuseColor(COLOR_LAVENDER); break;
+		case 11: setDiffuseColor(COLOR_SIENNA); break;
+		case 12: setDiffuseColor(COLOR_HOT_PINK); break;
+		case 13: setDiffuseColor(COLOR_CORAL); break;
+		case 14: setDiffuseColor(COLOR_MAROON); break;
+		case 15: setDiffuseColor(COLOR_GOLD); break;
+		case 16: setDiffuseColor(COLOR_SPRING_GREEN); break;
+		default: break;
+	}
+}
+
+#endif
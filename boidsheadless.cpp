@@ -0,0 +1,255 @@
+// boidsheadless.cpp
+
+// Runs the boids simulation without a window, for batch runs on machines
+// with no display. This builds without FLTK or OpenGL (see
+// boidsheadless.vcxproj). It prints how fast the simulation ran and a hash
+// of the final state, so two runs can be checked for identical results.
+//
+// usage: boidsheadless [options]
+//        --boids n         number of boids (default 8)
+//        --steps n         number of steps to run (default 1000)
+//        --seed n          seed for the starting positions (default 1)
+//        --perception d    how far away a boid can notice other boids
+//        --flock-d d       how close a boid lets other boids get
+//        --range d         the boundaries of the flock on each axis
+//        --speed d         the boids' top speed
+//        --threads n       how many threads to move the boids with
+//        --nearest k       flock with the k nearest boids, rather than by perception
+//        --theta d         count distant groups of boids as one (0 is exact)
+//        --skin d          keep each boid's neighbors for a few steps, with this margin
+//        --sort n          sort the boids by position every n steps
+//        --species n       split the boids between n species (up to 4)
+//        --species-params s p f v
+//                          perception, min distance and top speed of species s (1 and up;
+//                          species 0 uses --perception, --flock-d and --speed)
+//        --avoid d         how close boids let boids of other species get
+//        --circle-plant    boids circle the plant
+//        --perch           boids perch on the ground
+//        --wind            intermittent gusts of wind
+//        --search s        how to find neighbors: all, grid (default) or octree
+//        --no-simd         use the scalar flocking kernel
+//        --record file     record every step to a trajectory file (see trajectory.h)
+//        --half            record positions and velocities as 16 bit floats
+//        --load file       start from a checkpoint (see checkpoint.h) rather than
+//                          from --seed and --boids; the other options aren't saved,
+//                          so give the ones the checkpoint was run with
+//        --save file       save a checkpoint of the final state
+
+#include "boids.h"
+#include "trajectory.h"
+#include "checkpoint.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+/** @brief getTime - Get the current time in seconds
+ *
+ **/
+static double getTime()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** @brief printUsage - Print the command line options
+ *
+ **/
+static void printUsage()
+{
+	fprintf(stderr,
+	        "usage: boidsheadless [--boids n] [--steps n] [--seed n] [--perception d]\n"
+	        "                     [--flock-d d] [--range d] [--speed d] [--threads n]\n"
+	        "                     [--nearest k] [--theta d] [--skin d] [--sort n]\n"
+	        "                     [--species n] [--species-params s p f v] [--avoid d]\n"
+	        "                     [--search all|grid|octree] [--circle-plant] [--perch]\n"
+	        "                     [--wind] [--no-simd] [--record file] [--half]\n"
+	        "                     [--load file] [--save file]\n");
+}
+
+int main(int argc, char** argv)
+{
+	SimParams params;
+	int num_boids = 8;
+	int steps = 1000;
+	unsigned long long seed = 1;
+	const char* record_path = NULL;
+	bool record_half = false;
+	const char* load_path = NULL;
+	const char* save_path = NULL;
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		// the options that take a value
+		const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		if(strcmp(arg, "--boids") == 0 && value)
+			num_boids = atoi(argv[++i]);
+		else if(strcmp(arg, "--steps") == 0 && value)
+			steps = atoi(argv[++i]);
+		else if(strcmp(arg, "--seed") == 0 && value)
+			sscanf(argv[++i], "%llu", &seed);
+		else if(strcmp(arg, "--perception") == 0 && value)
+			params.perception = atof(argv[++i]);
+		else if(strcmp(arg, "--flock-d") == 0 && value)
+			params.flock_d = atof(argv[++i]);
+		else if(strcmp(arg, "--range") == 0 && value)
+			params.flock_range = atof(argv[++i]);
+		else if(strcmp(arg, "--speed") == 0 && value)
+			params.flock_speed = atof(argv[++i]);
+		else if(strcmp(arg, "--threads") == 0 && value)
+			params.threads = atoi(argv[++i]);
+		else if(strcmp(arg, "--nearest") == 0 && value)
+			params.nearest = atoi(argv[++i]);
+		else if(strcmp(arg, "--theta") == 0 && value)
+			params.theta = atof(argv[++i]);
+		else if(strcmp(arg, "--skin") == 0 && value)
+			params.skin = atof(argv[++i]);
+		else if(strcmp(arg, "--sort") == 0 && value)
+			params.sort_interval = atoi(argv[++i]);
+		else if(strcmp(arg, "--species") == 0 && value)
+			params.num_species = atoi(argv[++i]);
+		else if(strcmp(arg, "--species-params") == 0 && i + 4 < argc)
+		{
+			int species = atoi(argv[++i]);
+			if(species < 1 || species >= MAX_SPECIES)
+			{
+				printUsage();
+				return 1;
+			}
+			params.species[species - 1].perception = atof(argv[++i]);
+			params.species[species - 1].flock_d = atof(argv[++i]);
+			params.species[species - 1].flock_speed = atof(argv[++i]);
+		}
+		else if(strcmp(arg, "--avoid") == 0 && value)
+			params.avoid_d = atof(argv[++i]);
+		else if(strcmp(arg, "--record") == 0 && value)
+			record_path = argv[++i];
+		else if(strcmp(arg, "--load") == 0 && value)
+			load_path = argv[++i];
+		else if(strcmp(arg, "--save") == 0 && value)
+			save_path = argv[++i];
+		else if(strcmp(arg, "--search") == 0 && value)
+		{
+			const char* search = argv[++i];
+			if(strcmp(search, "all") == 0)
+				params.neighbor_search = SEARCH_ALL;
+			else if(strcmp(search, "grid") == 0)
+				params.neighbor_search = SEARCH_GRID;
+			else if(strcmp(search, "octree") == 0)
+				params.neighbor_search = SEARCH_OCTREE;
+			else
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		// and the ones that don't
+		else if(strcmp(arg, "--circle-plant") == 0)
+			params.circle_plant = true;
+		else if(strcmp(arg, "--perch") == 0)
+			params.can_perch = true;
+		else if(strcmp(arg, "--wind") == 0)
+			params.add_wind = true;
+		else if(strcmp(arg, "--no-simd") == 0)
+			params.simd = false;
+		else if(strcmp(arg, "--half") == 0)
+			record_half = true;
+		else if(strcmp(arg, "--help") == 0)
+		{
+			printUsage();
+			return 0;
+		}
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	// a perception of 0 would leave the neighbor search with cells of no size
+	bool bad_species = false;
+	for(int s = 0; s < MAX_SPECIES - 1; s++)
+	{
+		if(params.species[s].perception <= 0 || params.species[s].flock_d < 0 || params.species[s].flock_speed < 0)
+			bad_species = true;
+	}
+	if(num_boids < 0 || steps < 0 || params.threads < 1 || params.num_species < 1 ||
+	   params.num_species > MAX_SPECIES || params.perception <= 0 || params.flock_d < 0 ||
+	   params.flock_range < 0 || params.flock_speed < 0 || params.skin < 0 || params.avoid_d < 0 ||
+	   params.theta < 0 || bad_species)
+	{
+		printUsage();
+		return 1;
+	}
+
+	BoidSwarm boids;
+	seedBoids(seed);
+	if(load_path)
+	{
+		CheckpointReader checkpoint;
+		if(!checkpoint.load(load_path) || !loadBoids(checkpoint, boids))
+		{
+			fprintf(stderr, "couldn't load %s\n", load_path);
+			return 1;
+		}
+		num_boids = boids.size();
+	}
+	else
+		setBoidCount(boids, num_boids, params.num_species);
+
+	// the starting positions, then every step
+	TrajectoryRecorder recorder;
+	if(record_path && !recorder.open(record_path, record_half))
+	{
+		fprintf(stderr, "couldn't open %s\n", record_path);
+		return 1;
+	}
+	recorder.record(boids.current());
+
+	double start = getTime();
+	for(int i = 0; i < steps; i++)
+	{
+		moveBoids(boids, params);
+		recorder.record(boids.current());
+	}
+	double elapsed = getTime() - start;
+	if(record_path && !recorder.close())
+	{
+		fprintf(stderr, "couldn't write %s\n", record_path);
+		return 1;
+	}
+	if(save_path)
+	{
+		CheckpointWriter checkpoint;
+		saveBoids(checkpoint, boids);
+		if(!checkpoint.save(save_path))
+		{
+			fprintf(stderr, "couldn't write %s\n", save_path);
+			return 1;
+		}
+	}
+
+	printf("boids: %d\n", num_boids);
+	printf("steps: %d\n", steps);
+	printf("seconds: %.3f\n", elapsed);
+	if(elapsed > 0.0)
+		printf("boid-steps/s: %.0f\n", double(num_boids) * steps / elapsed);
+	if(params.num_species > 1 && steps > 0)
+	{
+		double species_seconds[MAX_SPECIES];
+		getSpeciesTimes(species_seconds);
+		for(int s = 0; s < params.num_species; s++)
+			printf("species %d: %d boids, %.3f ms/step\n", s, boids.getSpeciesCount(s),
+			       species_seconds[s] * 1000.0 / steps);
+	}
+	long long list_steps, list_rebuilds;
+	getNeighborListCounts(list_steps, list_rebuilds);
+	if(list_steps > 0)
+		printf("neighbor list rebuilds: %lld of %lld steps\n", list_rebuilds, list_steps);
+	printf("flock memory: %llu bytes in use, %llu reserved\n",
+	       (unsigned long long)boids.getBytesInUse(), (unsigned long long)boids.getBytesReserved());
+	if(record_path)
+		printf("recorded: %d frames to %s\n", recorder.getFrameCount(), record_path);
+	printf("hash: %016llx\n", boids.hash());
+	return 0;
+}
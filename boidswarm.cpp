@@ -0,0 +1,853 @@
+#include "boidswarm.h"
+#include "boids.h"
+#include "checkpoint.h"
+#include <algorithm>
+
+using namespace std;
+
+/** @brief BoidState::setArena - Choose the arena the state's arrays are kept in
+ *
+ * @param Arena arena - the arena; the state starts over empty
+ *
+ **/
+void BoidState::setArena(Arena* arena)
+{
+	m_pos_x.setArena(arena);
+	m_pos_y.setArena(arena);
+	m_pos_z.setArena(arena);
+	m_vel_x.setArena(arena);
+	m_vel_y.setArena(arena);
+	m_vel_z.setArena(arena);
+	m_perch_until.setArena(arena);
+	m_perching.setArena(arena);
+	m_slot.setArena(arena);
+	m_species.setArena(arena);
+}
+
+/** @brief BoidState::operator= - Copy another state's boids into this state's memory
+ *
+ **/
+BoidState& BoidState::operator=(const BoidState& other)
+{
+	if(this == &other)
+		return *this;
+	m_pos_x = other.m_pos_x;
+	m_pos_y = other.m_pos_y;
+	m_pos_z = other.m_pos_z;
+	m_vel_x = other.m_vel_x;
+	m_vel_y = other.m_vel_y;
+	m_vel_z = other.m_vel_z;
+	m_perch_until = other.m_perch_until;
+	m_perching = other.m_perching;
+	m_slot = other.m_slot;
+	m_species = other.m_species;
+	m_step = other.m_step;
+	return *this;
+}
+
+/** @brief BoidState::detach - Forget the arrays' memory, so the arena can be reset
+ *
+ **/
+void BoidState::detach()
+{
+	m_pos_x.detach();
+	m_pos_y.detach();
+	m_pos_z.detach();
+	m_vel_x.detach();
+	m_vel_y.detach();
+	m_vel_z.detach();
+	m_perch_until.detach();
+	m_perching.detach();
+	m_slot.detach();
+	m_species.detach();
+	m_step = 0;
+}
+
+/** @brief BoidState::reserve - Make room for a number of boids up front, so adding
+ *                             them doesn't have to grow the arrays bit by bit
+ *
+ * @param int capacity - how many boids to make room for
+ *
+ **/
+void BoidState::reserve(int capacity)
+{
+	m_pos_x.reserve(capacity);
+	m_pos_y.reserve(capacity);
+	m_pos_z.reserve(capacity);
+	m_vel_x.reserve(capacity);
+	m_vel_y.reserve(capacity);
+	m_vel_z.reserve(capacity);
+	m_perch_until.reserve(capacity);
+	m_perching.reserve(capacity);
+	m_slot.reserve(capacity);
+	m_species.reserve(capacity);
+}
+
+/** @brief BoidState::addBoid - Add a new boid to the end of the state arrays
+ *
+ * @param Vec3d pos - the boid's starting position
+ * @param Vec3d v - the boid's starting velocity
+ * @param int slot - the swarm's slot for the boid
+ * @param int species - the boid's species
+ *
+ **/
+void BoidState::addBoid(const Vec3d& pos, const Vec3d& v, int slot, int species)
+{
+	m_pos_x.push_back(pos[0]);
+	m_pos_y.push_back(pos[1]);
+	m_pos_z.push_back(pos[2]);
+	m_vel_x.push_back(v[0]);
+	m_vel_y.push_back(v[1]);
+	m_vel_z.push_back(v[2]);
+	m_perch_until.push_back(0);
+	m_perching.push_back(false);
+	m_slot.push_back(slot);
+	m_species.push_back((unsigned char)species);
+}
+
+/** @brief BoidState::setBoid - Put a new boid in place of another
+ *
+ * @param int i - the index to put the boid at
+ * @param Vec3d pos - the boid's starting position
+ * @param Vec3d v - the boid's starting velocity
+ * @param int slot - the swarm's slot for the boid
+ * @param int species - the boid's species
+ *
+ **/
+void BoidState::setBoid(int i, const Vec3d& pos, const Vec3d& v, int slot, int species)
+{
+	m_pos_x[i] = pos[0];
+	m_pos_y[i] = pos[1];
+	m_pos_z[i] = pos[2];
+	m_vel_x[i] = v[0];
+	m_vel_y[i] = v[1];
+	m_vel_z[i] = v[2];
+	m_perch_until[i] = 0;
+	m_perching[i] = false;
+	m_slot[i] = slot;
+	m_species[i] = (unsigned char)species;
+}
+
+/** @brief BoidState::copyBoid - Copy one boid over another
+ *
+ * @param int from - the index of the boid to copy
+ * @param int to - the index to copy it to
+ *
+ **/
+void BoidState::copyBoid(int from, int to)
+{
+	m_pos_x[to] = m_pos_x[from];
+	m_pos_y[to] = m_pos_y[from];
+	m_pos_z[to] = m_pos_z[from];
+	m_vel_x[to] = m_vel_x[from];
+	m_vel_y[to] = m_vel_y[from];
+	m_vel_z[to] = m_vel_z[from];
+	m_perch_until[to] = m_perch_until[from];
+	m_perching[to] = m_perching[from];
+	m_slot[to] = m_slot[from];
+	m_species[to] = m_species[from];
+}
+
+/** @brief BoidState::removeLastBoid - Remove the boid at the end of the arrays
+ *
+ **/
+void BoidState::removeLastBoid()
+{
+	m_pos_x.pop_back();
+	m_pos_y.pop_back();
+	m_pos_z.pop_back();
+	m_vel_x.pop_back();
+	m_vel_y.pop_back();
+	m_vel_z.pop_back();
+	m_perch_until.pop_back();
+	m_perching.pop_back();
+	m_slot.pop_back();
+	m_species.pop_back();
+}
+
+/** @brief BoidState::clear - Remove every boid from the state arrays
+ *
+ **/
+void BoidState::clear()
+{
+	m_pos_x.clear();
+	m_pos_y.clear();
+	m_pos_z.clear();
+	m_vel_x.clear();
+	m_vel_y.clear();
+	m_vel_z.clear();
+	m_perch_until.clear();
+	m_perching.clear();
+	m_slot.clear();
+	m_species.clear();
+	m_step = 0;
+}
+
+/** @brief BoidState::reorder - Make this a copy of another state with the boids in a
+ *                              different order
+ *
+ * @param BoidState from - the state to copy
+ * @param int* order - for each index here, the index of the boid in 'from'
+ *                     that goes there
+ * @param int count - how many boids there are
+ *
+ **/
+void BoidState::reorder(const BoidState& from, const int* order, int count)
+{
+	size_t n = size_t(count);
+	m_pos_x.resize(n);
+	m_pos_y.resize(n);
+	m_pos_z.resize(n);
+	m_vel_x.resize(n);
+	m_vel_y.resize(n);
+	m_vel_z.resize(n);
+	m_perch_until.resize(n);
+	m_perching.resize(n);
+	m_slot.resize(n);
+	m_species.resize(n);
+	for(size_t i = 0; i < n; i++)
+	{
+		int j = order[i];
+		m_pos_x[i] = from.m_pos_x[j];
+		m_pos_y[i] = from.m_pos_y[j];
+		m_pos_z[i] = from.m_pos_z[j];
+		m_vel_x[i] = from.m_vel_x[j];
+		m_vel_y[i] = from.m_vel_y[j];
+		m_vel_z[i] = from.m_vel_z[j];
+		m_perch_until[i] = from.m_perch_until[j];
+		m_perching[i] = from.m_perching[j];
+		m_slot[i] = from.m_slot[j];
+		m_species[i] = from.m_species[j];
+	}
+	m_step = from.m_step;
+}
+
+/** @brief hashBytes - Add some bytes to a 64-bit FNV-1a hash
+ *
+ * @param unsigned long long hash - the hash so far
+ * @param void* data - the bytes to add
+ * @param size_t size - how many bytes to add
+ * @return unsigned long long - the new hash
+ *
+ **/
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/** @brief BoidState::hash - Hash every boid's state, to tell whether two runs
+ *                           ended up in exactly the same place
+ *
+ * @return unsigned long long - a hash of the exact bits of every component
+ *
+ **/
+unsigned long long BoidState::hash() const
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	if(empty())
+		return hash;
+	size_t n = m_pos_x.size();
+	hash = hashBytes(hash, m_pos_x.data(), n * sizeof(double));
+	hash = hashBytes(hash, m_pos_y.data(), n * sizeof(double));
+	hash = hashBytes(hash, m_pos_z.data(), n * sizeof(double));
+	hash = hashBytes(hash, m_vel_x.data(), n * sizeof(double));
+	hash = hashBytes(hash, m_vel_y.data(), n * sizeof(double));
+	hash = hashBytes(hash, m_vel_z.data(), n * sizeof(double));
+	// the time left on each perch timer, rather than the step it runs out on
+	for(size_t i = 0; i < n; i++)
+	{
+		int time = getPerchTimer(int(i));
+		hash = hashBytes(hash, &time, sizeof(int));
+	}
+	hash = hashBytes(hash, m_perching.data(), n * sizeof(unsigned char));
+	return hash;
+}
+
+/** @brief BoidState::save - Write every boid's state, and the step, to a checkpoint
+ *
+ * @param CheckpointWriter out - the checkpoint, with the swarm's section open
+ *
+ **/
+void BoidState::save(CheckpointWriter& out) const
+{
+	int n = size();
+	out.write(n);
+	out.write(m_step);
+	out.writeArray(m_pos_x.data(), n);
+	out.writeArray(m_pos_y.data(), n);
+	out.writeArray(m_pos_z.data(), n);
+	out.writeArray(m_vel_x.data(), n);
+	out.writeArray(m_vel_y.data(), n);
+	out.writeArray(m_vel_z.data(), n);
+	out.writeArray(m_perch_until.data(), n);
+	out.writeArray(m_perching.data(), n);
+	out.writeArray(m_slot.data(), n);
+	out.writeArray(m_species.data(), n);
+}
+
+/** @brief BoidState::load - Replace the state with the one saved by save()
+ *
+ * @param CheckpointReader in - the checkpoint, reading the swarm's section
+ * @return bool - false if the section is cut short
+ *
+ **/
+bool BoidState::load(CheckpointReader& in)
+{
+	int n, step;
+	if(!in.read(n) || !in.read(step))
+		return false;
+	// what each boid takes up, so a bad count can't ask for more memory than
+	// the file could fill
+	size_t boid_bytes = 6 * sizeof(double) + sizeof(int) + 1 + sizeof(int) + 1;
+	if(n < 0 || size_t(n) > in.getBytesLeft() / boid_bytes)
+		return false;
+
+	m_pos_x.resize(n);
+	m_pos_y.resize(n);
+	m_pos_z.resize(n);
+	m_vel_x.resize(n);
+	m_vel_y.resize(n);
+	m_vel_z.resize(n);
+	m_perch_until.resize(n);
+	m_perching.resize(n);
+	m_slot.resize(n);
+	m_species.resize(n);
+	m_step = step;
+	return in.readArray(m_pos_x.data(), n) && in.readArray(m_pos_y.data(), n) &&
+	       in.readArray(m_pos_z.data(), n) && in.readArray(m_vel_x.data(), n) &&
+	       in.readArray(m_vel_y.data(), n) && in.readArray(m_vel_z.data(), n) &&
+	       in.readArray(m_perch_until.data(), n) && in.readArray(m_perching.data(), n) &&
+	       in.readArray(m_slot.data(), n) && in.readArray(m_species.data(), n);
+}
+
+BoidSwarm::BoidSwarm()
+	: m_current(0), m_reschedule(false), m_changes(0)
+{
+	m_states[0].setArena(&m_arena);
+	m_states[1].setArena(&m_arena);
+	for(int s = 0; s <= MAX_SPECIES; s++)
+		m_species_begin[s] = 0;
+}
+
+BoidSwarm::BoidSwarm(const BoidSwarm& other)
+	: m_current(0), m_reschedule(false), m_changes(0)
+{
+	m_states[0].setArena(&m_arena);
+	m_states[1].setArena(&m_arena);
+	*this = other;
+}
+
+/** @brief BoidSwarm::operator= - Copy another swarm's boids into this swarm's memory
+ *
+ * The change count isn't copied but goes up, as every boid may have changed.
+ *
+ **/
+BoidSwarm& BoidSwarm::operator=(const BoidSwarm& other)
+{
+	if(this == &other)
+		return *this;
+	m_states[0] = other.m_states[0];
+	m_states[1] = other.m_states[1];
+	m_current = other.m_current;
+	m_slot_index = other.m_slot_index;
+	m_generation = other.m_generation;
+	m_free_slots = other.m_free_slots;
+	for(int s = 0; s <= MAX_SPECIES; s++)
+		m_species_begin[s] = other.m_species_begin[s];
+	m_active = other.m_active;
+	m_wheel = other.m_wheel;
+	m_reschedule = other.m_reschedule;
+	m_changes++;
+	return *this;
+}
+
+/** @brief BoidSwarm::moveBoid - Move a boid to another index, in place of whatever was there
+ *
+ * @param int from - the boid's index
+ * @param int to - the index to move it to
+ *
+ **/
+void BoidSwarm::moveBoid(int from, int to)
+{
+	if(from == to)
+		return;
+	current().copyBoid(from, to);
+	m_slot_index[current().getSlot(to)] = to;
+	// the lists are made again from scratch before the next step, rather than
+	// searched for the indices that changed
+	m_reschedule = true;
+}
+
+/** @brief BoidSwarm::spawnBoid - Add a new boid to the end of its species
+ *
+ * To make room, the first boid of each later species moves to the end of its
+ * species, so spawning takes at most one move per species.
+ *
+ * @param Vec3d pos - the boid's starting position
+ * @param Vec3d v - the boid's starting velocity
+ * @param int species - the boid's species
+ * @return BoidHandle - a handle that finds the new boid until it's despawned
+ *
+ **/
+BoidHandle BoidSwarm::spawnBoid(const Vec3d& pos, const Vec3d& v, int species)
+{
+	if(species < 0 || species >= MAX_SPECIES)
+		species = 0;
+
+	int slot;
+	if(!m_free_slots.empty())
+	{
+		slot = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+	else
+	{
+		slot = int(m_slot_index.size());
+		m_slot_index.push_back(-1);
+		m_generation.push_back(0);
+	}
+
+	// the arrays grow by one at the end, then each later species moves its
+	// first boid into the space at its end, until there's a space at the end
+	// of the new boid's species
+	int hole = size();
+	current().addBoid(pos, v, slot, species);
+	m_species_begin[MAX_SPECIES]++;
+	for(int s = MAX_SPECIES - 1; s > species; s--)
+	{
+		moveBoid(m_species_begin[s], hole);
+		hole = m_species_begin[s];
+		m_species_begin[s]++;
+	}
+	if(hole != size() - 1)
+		current().setBoid(hole, pos, v, slot, species);
+	m_slot_index[slot] = hole;
+	// new boids aren't perching, and if nothing had to move they come after
+	// every other boid
+	if(!m_reschedule)
+		m_active.push_back(hole);
+	m_changes++;
+
+	BoidHandle handle = {slot, m_generation[slot]};
+	return handle;
+}
+
+/** @brief BoidSwarm::reserve - Make room for a number of boids up front
+ *
+ * @param int capacity - how many boids to make room for
+ *
+ **/
+void BoidSwarm::reserve(int capacity)
+{
+	m_states[0].reserve(capacity);
+	m_states[1].reserve(capacity);
+}
+
+/** @brief BoidSwarm::despawnBoid - Remove a boid from the swarm
+ *
+ * The last boid of its species takes the removed boid's index, then the last
+ * boid of each later species moves back into the space left behind.
+ *
+ * @param BoidHandle handle - the boid to remove
+ * @return bool - false if the boid had already been despawned
+ *
+ **/
+bool BoidSwarm::despawnBoid(const BoidHandle& handle)
+{
+	int i = findBoid(handle);
+	if(i < 0)
+		return false;
+
+	int species = current().getSpecies(i);
+	int hole = m_species_begin[species + 1] - 1;
+	moveBoid(hole, i);
+	for(int s = species + 1; s < MAX_SPECIES; s++)
+	{
+		m_species_begin[s]--;
+		if(m_species_begin[s + 1] - 1 > hole)
+		{
+			moveBoid(m_species_begin[s + 1] - 1, hole);
+			hole = m_species_begin[s + 1] - 1;
+		}
+	}
+	m_species_begin[MAX_SPECIES]--;
+	current().removeLastBoid();
+	m_slot_index[handle.slot] = -1;
+	// old handles to this slot stop finding anything
+	m_generation[handle.slot]++;
+	m_free_slots.push_back(handle.slot);
+
+	m_reschedule = true;
+	m_changes++;
+	return true;
+}
+
+/** @brief BoidSwarm::getHandle - Get a handle to a boid, to find it again later
+ *
+ * @param int i - the boid's index
+ * @return BoidHandle - a handle that finds the boid until it's despawned
+ *
+ **/
+BoidHandle BoidSwarm::getHandle(int i) const
+{
+	int slot = current().getSlot(i);
+	BoidHandle handle = {slot, m_generation[slot]};
+	return handle;
+}
+
+/** @brief BoidSwarm::findBoid - Find the boid a handle refers to
+ *
+ * @param BoidHandle handle
+ * @return int - the boid's index, or -1 if it has been despawned
+ *
+ **/
+int BoidSwarm::findBoid(const BoidHandle& handle) const
+{
+	if(handle.slot < 0 || handle.slot >= int(m_slot_index.size()) ||
+	   m_generation[handle.slot] != handle.generation)
+		return -1;
+	return m_slot_index[handle.slot];
+}
+
+/** @brief BoidSwarm::getPerchingCount - Count the boids perching until their timers run out
+ *
+ **/
+int BoidSwarm::getPerchingCount() const
+{
+	if(!m_reschedule)
+		return size() - int(m_active.size());
+	int count = 0;
+	for(int i = 0; i < size(); i++)
+		if(current().isPerching(i) && current().getPerchTimer(i) > 0)
+			count++;
+	return count;
+}
+
+/** @brief BoidSwarm::clear - Remove every boid from the swarm
+ *
+ * All of the flock's memory goes back to the arena in one go, to be reused by
+ * the next boids spawned.
+ *
+ **/
+void BoidSwarm::clear()
+{
+	m_states[0].detach();
+	m_states[1].detach();
+	m_arena.reset();
+	m_slot_index.clear();
+	m_generation.clear();
+	m_free_slots.clear();
+	for(int s = 0; s <= MAX_SPECIES; s++)
+		m_species_begin[s] = 0;
+	m_active.clear();
+	m_wheel.clear();
+	m_reschedule = false;
+	m_changes++;
+}
+
+/** @brief BoidSwarm::save - Write the swarm into its own section of a checkpoint
+ *
+ * The boids' states and the slot map are saved as they are, so handles made
+ * before saving still find their boids after loading. The active list and
+ * the timing wheel are made again from the perch timers.
+ *
+ * @param CheckpointWriter out
+ *
+ **/
+void BoidSwarm::save(CheckpointWriter& out) const
+{
+	out.beginSection("SWRM");
+	current().save(out);
+	int slots = int(m_slot_index.size());
+	out.write(slots);
+	out.writeArray(m_slot_index.data(), slots);
+	out.writeArray(m_generation.data(), slots);
+	int free_slots = int(m_free_slots.size());
+	out.write(free_slots);
+	out.writeArray(m_free_slots.data(), free_slots);
+	out.endSection();
+}
+
+/** @brief BoidSwarm::load - Replace the swarm with the one saved in a checkpoint
+ *
+ * @param CheckpointReader in
+ * @return bool - false if the checkpoint has no swarm, or a damaged one; the
+ *                swarm is left as it was
+ *
+ **/
+bool BoidSwarm::load(CheckpointReader& in)
+{
+	if(!in.findSection("SWRM"))
+		return false;
+
+	// loaded on the side, so a bad checkpoint doesn't leave half a swarm
+	BoidSwarm loaded;
+	BoidState& state = loaded.current();
+	int slots, free_slots;
+	if(!state.load(in) || !in.read(slots) || slots < 0 || size_t(slots) > in.getBytesLeft())
+		return false;
+	loaded.m_slot_index.resize(slots);
+	loaded.m_generation.resize(slots);
+	if(!in.readArray(loaded.m_slot_index.data(), slots) || !in.readArray(loaded.m_generation.data(), slots) ||
+	   !in.read(free_slots) || free_slots < 0 || free_slots > slots)
+		return false;
+	loaded.m_free_slots.resize(free_slots);
+	if(!in.readArray(loaded.m_free_slots.data(), free_slots))
+		return false;
+
+	// every boid's slot has to lead back to it, and each species has to be in one piece
+	int n = state.size();
+	for(int i = 0; i < n; i++)
+	{
+		int slot = state.getSlot(i);
+		int species = state.getSpecies(i);
+		if(slot < 0 || slot >= slots || loaded.m_slot_index[slot] != i || species >= MAX_SPECIES ||
+		   (i > 0 && species < state.getSpecies(i - 1)))
+			return false;
+	}
+	int used_slots = 0;
+	for(int slot = 0; slot < slots; slot++)
+	{
+		if(loaded.m_slot_index[slot] != -1)
+			used_slots++;
+	}
+	if(used_slots != n)
+		return false;
+	// and every free slot has to be unused, and free only once, or two spawns
+	// would get the same slot
+	vector<bool> listed(slots, false);
+	for(int f = 0; f < free_slots; f++)
+	{
+		int slot = loaded.m_free_slots[f];
+		if(slot < 0 || slot >= slots || loaded.m_slot_index[slot] != -1 || listed[slot])
+			return false;
+		listed[slot] = true;
+	}
+
+	int species = 0;
+	for(int i = 0; i <= n; i++)
+	{
+		int next = (i < n) ? state.getSpecies(i) : MAX_SPECIES;
+		while(species < next)
+			loaded.m_species_begin[++species] = i;
+	}
+	loaded.m_reschedule = true;
+	// (which counts as a change)
+	*this = loaded;
+	return true;
+}
+
+/** @brief spreadBits - Spread the low 21 bits of a number out to every third bit
+ *
+ **/
+static unsigned long long spreadBits(unsigned long long x)
+{
+	x &= 0x1FFFFFULL;
+	x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+	x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+	x = (x | (x << 8)) & 0x100F00F00F00F00FULL;
+	x = (x | (x << 4)) & 0x10C30C30C30C30C3ULL;
+	x = (x | (x << 2)) & 0x1249249249249249ULL;
+	return x;
+}
+
+// a boid's place on the Morton curve
+struct SortKey
+{
+	int species;
+	unsigned long long key;
+	int index;
+};
+
+/** @brief compareSortKeys - Order boids by species, then along the Morton curve, and
+ *                           by index where they share a place on it
+ *
+ **/
+static bool compareSortKeys(const SortKey& a, const SortKey& b)
+{
+	if(a.species != b.species)
+		return a.species < b.species;
+	return (a.key != b.key) ? a.key < b.key : a.index < b.index;
+}
+
+/** @brief BoidSwarm::sortByPosition - Sort the boids along a Morton (Z-order) curve
+ *                                     through their positions
+ *
+ * Boids that are close together in space end up close together in the arrays,
+ * so the neighbors a boid looks at are mostly in memory it (or the boid before
+ * it) has just read. Each species stays together, and handles to the boids
+ * still find them (see findBoid()).
+ *
+ **/
+void BoidSwarm::sortByPosition()
+{
+	const BoidState& state = current();
+	int n = size();
+	if(n < 2)
+		return;
+
+	// the bounds of the flock, split into 2^21 steps on each axis
+	double low[3], high[3];
+	for(int k = 0; k < 3; k++)
+	{
+		low[k] = HUGE_VAL;
+		high[k] = -HUGE_VAL;
+	}
+	for(int i = 0; i < n; i++)
+	{
+		Vec3d pos = state.getPosition(i);
+		for(int k = 0; k < 3; k++)
+		{
+			low[k] = min(low[k], pos[k]);
+			high[k] = max(high[k], pos[k]);
+		}
+	}
+	double scale[3];
+	for(int k = 0; k < 3; k++)
+		scale[k] = (high[k] > low[k]) ? 2097151.0 / (high[k] - low[k]) : 0.0;
+
+	// the keys and the new order are only needed until the boids are moved
+	m_scratch.reset();
+	SortKey* keys = m_scratch.allocateArray<SortKey>(n);
+	for(int i = 0; i < n; i++)
+	{
+		Vec3d pos = state.getPosition(i);
+		keys[i].key = 0;
+		for(int k = 0; k < 3; k++)
+			keys[i].key |= spreadBits((unsigned long long)((pos[k] - low[k]) * scale[k])) << k;
+		keys[i].species = state.getSpecies(i);
+		keys[i].index = i;
+	}
+	sort(keys, keys + n, compareSortKeys);
+
+	int* order = m_scratch.allocateArray<int>(n);
+	for(int i = 0; i < n; i++)
+		order[i] = keys[i].index;
+	m_states[1 - m_current].reorder(state, order, n);
+	m_current = 1 - m_current;
+
+	for(int i = 0; i < n; i++)
+		m_slot_index[current().getSlot(i)] = i;
+	// the lists hold indices, which have all just changed
+	rescheduleBoids();
+	m_changes++;
+}
+
+/** @brief BoidSwarm::scheduleBoid - Put a boid on the timing wheel if it's perching,
+ *                                   or on the active list if it isn't
+ *
+ * @param int i - the boid's index
+ *
+ **/
+void BoidSwarm::scheduleBoid(int i)
+{
+	const BoidState& state = current();
+	if(!state.isPerching(i) || state.getPerchTimer(i) <= 0)
+	{
+		m_active.push_back(i);
+		return;
+	}
+	if(m_wheel.empty())
+		m_wheel.resize(WHEEL_SIZE);
+	m_wheel[state.getPerchUntil(i) % WHEEL_SIZE].push_back(i);
+}
+
+/** @brief BoidSwarm::rescheduleBoids - Sort every boid onto the active list or the
+ *                                      timing wheel from scratch
+ *
+ **/
+void BoidSwarm::rescheduleBoids()
+{
+	m_active.clear();
+	for(int s = 0; s < int(m_wheel.size()); s++)
+		m_wheel[s].clear();
+	for(int i = 0; i < size(); i++)
+		scheduleBoid(i);
+	m_reschedule = false;
+}
+
+/** @brief BoidSwarm::getBoid - Get a view of a single boid in the swarm
+ *
+ * @param int i - the boid's index
+ * @return Boid - a view that reads and writes the boid's current state
+ *
+ **/
+Boid BoidSwarm::getBoid(int i)
+{
+	return Boid(&current(), i);
+}
+
+/** @brief BoidSwarm::beginStep - Start a simulation step
+ *
+ * Perching boids whose timers have run out are woken up, and join the active
+ * list (see getActiveBoids()) for this step.
+ *
+ * @return BoidState - the state to write the step's results into; it starts out
+ *                     as a copy of the current state, which stays untouched
+ *                     until endStep()
+ *
+ **/
+BoidState& BoidSwarm::beginStep()
+{
+	if(m_reschedule)
+		rescheduleBoids();
+
+	// wake the boids whose timers have run out, so they move this step
+	int step = current().getStep();
+	if(!m_wheel.empty())
+	{
+		vector<int>& slot = m_wheel[step % WHEEL_SIZE];
+		m_woken.clear();
+		int kept = 0;
+		for(int k = 0; k < int(slot.size()); k++)
+		{
+			// boids perched for longer than the wheel wait for a later turn
+			if(current().getPerchUntil(slot[k]) <= step)
+				m_woken.push_back(slot[k]);
+			else
+				slot[kept++] = slot[k];
+		}
+		slot.resize(kept);
+		if(!m_woken.empty())
+		{
+			sort(m_woken.begin(), m_woken.end());
+			int middle = int(m_active.size());
+			m_active.insert(m_active.end(), m_woken.begin(), m_woken.end());
+			inplace_merge(m_active.begin(), m_active.begin() + middle, m_active.end());
+		}
+	}
+
+	BoidState& next = m_states[1 - m_current];
+	next = current();
+	next.setStep(step + 1);
+	return next;
+}
+
+/** @brief BoidSwarm::endStep - Finish a simulation step, making the state written
+ *                              since beginStep() the current one
+ *
+ * Active boids that started perching during the step go onto the timing wheel.
+ *
+ **/
+void BoidSwarm::endStep()
+{
+	m_current = 1 - m_current;
+
+	// boids that have just started perching leave the active list
+	int kept = 0;
+	for(int k = 0; k < int(m_active.size()); k++)
+	{
+		int i = m_active[k];
+		if(current().isPerching(i) && current().getPerchTimer(i) > 0)
+			scheduleBoid(i);
+		else
+			m_active[kept++] = i;
+	}
+	m_active.resize(kept);
+}
@@ -0,0 +1,211 @@
+// boidswarm.h
+
+// Storage for the whole flock. Rather than allocating every boid on
+// its own, each component (position, velocity, perch timer, ...) is kept
+// in its own contiguous array, so loops over the flock read memory in
+// order. Use a Boid (see boids.h) to work with a single boid in the swarm.
+//
+// The swarm keeps two copies of this state. A simulation step reads only
+// the current one and writes the next one, then swaps them, so every boid
+// sees the same snapshot of its neighbors no matter what order (or on how
+// many threads) the boids are updated.
+//
+// Boids of each species are kept together: the arrays hold every boid of
+// species 0, then every boid of species 1, and so on, so each species can
+// be run through in a loop of its own (see getSpeciesBegin()).
+//
+// The arrays live in the swarm's arena (see arena.h), so clearing the swarm
+// gives all of their memory back at once, and the next flock reuses it.
+//
+// Boids are spawned and despawned through a slot map: each boid holds a
+// slot, and the swarm keeps where in the arrays each slot's boid is. A
+// despawned boid's place is filled by the last boid, so the arrays stay
+// packed, and its slot goes on a free list for the next spawn. A
+// BoidHandle (slot plus generation) keeps finding the same boid however the
+// swarm is sorted (see BoidSwarm::sortByPosition()) or resized, and stops
+// finding anything once that boid is despawned.
+//
+// Perching boids sit still until their perch timer runs out, so the swarm
+// keeps the boids that move in a step (the active list) apart from the
+// perching ones, which wait on a timing wheel, filed under the step they
+// wake up on. A step only has to look at the active list, and a perching
+// boid costs nothing until it wakes (though the others still see it as a
+// neighbor). The timers aren't counted down either: a state keeps the step
+// each boid wakes up on, and works out the time left from its own step.
+
+#ifndef BOIDSWARM_H
+#define BOIDSWARM_H
+
+#include "vec.h"
+#include "arena.h"
+#include "simparams.h"
+#include <vector>
+
+class Boid;
+class CheckpointWriter;
+class CheckpointReader;
+
+// refers to a single boid for as long as it's alive
+struct BoidHandle
+{
+	int slot;
+	unsigned int generation;
+};
+
+// The state of every boid in the swarm, one array per component
+class BoidState
+{
+public:
+	BoidState() : m_step(0) {}
+	BoidState& operator=(const BoidState& other);
+
+	int size() const {return int(m_pos_x.size());}
+	bool empty() const {return m_pos_x.empty();}
+
+	void setArena(Arena* arena);
+	void detach();
+	void reserve(int capacity);
+
+	void addBoid(const Vec3d& pos, const Vec3d& v, int slot, int species);
+	void setBoid(int i, const Vec3d& pos, const Vec3d& v, int slot, int species);
+	void copyBoid(int from, int to);
+	void removeLastBoid();
+	void clear();
+	void reorder(const BoidState& from, const int* order, int count);
+	unsigned long long hash() const;
+	void save(CheckpointWriter& out) const;
+	bool load(CheckpointReader& in);
+
+	int getSlot(int i) const {return m_slot[i];}
+	int getSpecies(int i) const {return m_species[i];}
+
+	Vec3d getPosition(int i) const {return Vec3d(m_pos_x[i], m_pos_y[i], m_pos_z[i]);}
+	Vec3d getVelocity(int i) const {return Vec3d(m_vel_x[i], m_vel_y[i], m_vel_z[i]);}
+	void setPosition(int i, const Vec3d& pos) {m_pos_x[i] = pos[0]; m_pos_y[i] = pos[1]; m_pos_z[i] = pos[2];}
+	void setVelocity(int i, const Vec3d& v) {m_vel_x[i] = v[0]; m_vel_y[i] = v[1]; m_vel_z[i] = v[2];}
+
+	// how many more steps a perching boid stays perched
+	int getPerchTimer(int i) const {return (m_perch_until[i] > m_step) ? m_perch_until[i] - m_step : 0;}
+	void setPerchTimer(int i, int time) {m_perch_until[i] = m_step + time;}
+	// the step a perching boid wakes up on
+	int getPerchUntil(int i) const {return m_perch_until[i];}
+	// how many steps the simulation has taken to reach this state
+	int getStep() const {return m_step;}
+	void setStep(int step) {m_step = step;}
+	bool isPerching(int i) const {return m_perching[i] != 0;}
+	void setPerching(int i, bool perching) {m_perching[i] = perching;}
+
+	// direct access to the component arrays, for loops over the whole flock
+	const double* posX() const {return m_pos_x.data();}
+	const double* posY() const {return m_pos_y.data();}
+	const double* posZ() const {return m_pos_z.data();}
+	const double* velX() const {return m_vel_x.data();}
+	const double* velY() const {return m_vel_y.data();}
+	const double* velZ() const {return m_vel_z.data();}
+
+private:
+	// a state can be assigned, copying into its own arena's memory, but not
+	// copy-constructed, since a new state has no arena to copy into yet
+	BoidState(const BoidState&);
+
+	ArenaArray<double> m_pos_x, m_pos_y, m_pos_z;
+	ArenaArray<double> m_vel_x, m_vel_y, m_vel_z;
+	ArenaArray<int> m_perch_until;
+	ArenaArray<unsigned char> m_perching;
+	ArenaArray<int> m_slot;
+	ArenaArray<unsigned char> m_species;
+	int m_step;
+};
+
+class BoidSwarm
+{
+public:
+	BoidSwarm();
+	BoidSwarm(const BoidSwarm& other);
+	BoidSwarm& operator=(const BoidSwarm& other);
+
+	int size() const {return current().size();}
+	bool empty() const {return current().empty();}
+
+	BoidHandle spawnBoid(const Vec3d& pos, const Vec3d& v, int species = 0);
+	bool despawnBoid(const BoidHandle& handle);
+	void reserve(int capacity);
+	void clear();
+	void sortByPosition();
+	Boid getBoid(int i);
+	unsigned long long hash() const {return current().hash();}
+	// goes up whenever boids are spawned, despawned or renumbered, so anything
+	// kept by index (see VerletLists) can tell it's out of date
+	unsigned int getChangeCount() const {return m_changes;}
+
+	// write the swarm into a checkpoint (see checkpoint.h), or replace it with
+	// the one in a checkpoint
+	void save(CheckpointWriter& out) const;
+	bool load(CheckpointReader& in);
+
+	// the memory the flock's arrays take up, and what the swarm holds onto
+	size_t getBytesInUse() const {return m_arena.getBytesInUse();}
+	size_t getBytesReserved() const {return m_arena.getBytesReserved() + m_scratch.getBytesReserved();}
+
+	Vec3d getPosition(int i) const {return current().getPosition(i);}
+	Vec3d getVelocity(int i) const {return current().getVelocity(i);}
+	int getPerchTimer(int i) const {return current().getPerchTimer(i);}
+	bool isPerching(int i) const {return current().isPerching(i);}
+	BoidHandle getHandle(int i) const;
+	// the index of the boid a handle refers to, or -1 if it has been despawned
+	int findBoid(const BoidHandle& handle) const;
+
+	// the boids of a species are the ones from getSpeciesBegin(s) up to
+	// getSpeciesBegin(s + 1)
+	int getSpecies(int i) const {return current().getSpecies(i);}
+	int getSpeciesBegin(int species) const {return m_species_begin[species];}
+	int getSpeciesCount(int species) const {return m_species_begin[species + 1] - m_species_begin[species];}
+
+	// the boids that move in this step, in index order (up to date once
+	// beginStep() has been called)
+	const std::vector<int>& getActiveBoids() const {return m_active;}
+	int getPerchingCount() const;
+	// sort every boid onto the active list or the timing wheel again, after
+	// changing perch state outside of a step
+	void rescheduleBoids();
+
+	// the state as of the last step
+	BoidState& current() {return m_states[m_current];}
+	const BoidState& current() const {return m_states[m_current];}
+
+	BoidState& beginStep();
+	void endStep();
+
+private:
+	// steps on the timing wheel; a boid perched for longer goes around more than once
+	static const int WHEEL_SIZE = 128;
+
+	void scheduleBoid(int i);
+	void moveBoid(int from, int to);
+
+	// the states' arrays, and working space for sorting
+	Arena m_arena;
+	Arena m_scratch;
+
+	BoidState m_states[2];
+	int m_current;
+
+	// where each slot's boid is in the arrays (-1 for a free slot), how many
+	// times each slot has been reused, and the free slots
+	std::vector<int> m_slot_index;
+	std::vector<unsigned int> m_generation;
+	std::vector<int> m_free_slots;
+
+	// where each species starts in the arrays; the last entry is the size
+	int m_species_begin[MAX_SPECIES + 1];
+
+	std::vector<int> m_active;
+	std::vector<std::vector<int> > m_wheel;
+	// boids that woke up this step, waiting to be merged into the active list
+	std::vector<int> m_woken;
+	// boids have been despawned since the lists were last made
+	bool m_reschedule;
+	unsigned int m_changes;
+};
+
+#endif
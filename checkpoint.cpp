@@ -0,0 +1,149 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static const char CHECKPOINT_MAGIC[8] = {'B', 'O', 'I', 'D', 'C', 'K', 'P', 'T'};
+// the magic and the version
+static const size_t HEADER_SIZE = sizeof(CHECKPOINT_MAGIC) + sizeof(unsigned int);
+// a section's tag and size
+static const size_t SECTION_HEADER_SIZE = 4 + sizeof(unsigned int);
+
+CheckpointWriter::CheckpointWriter()
+	: m_section(0)
+{
+	writeBytes(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	write(CHECKPOINT_VERSION);
+}
+
+/** @brief CheckpointWriter::beginSection - Start a new section
+ *
+ * @param char tag - the section's name, four letters long
+ *
+ **/
+void CheckpointWriter::beginSection(const char* tag)
+{
+	writeBytes(tag, 4);
+	// the size is filled in by endSection()
+	m_section = m_data.size();
+	write(0u);
+}
+
+/** @brief CheckpointWriter::endSection - Finish the section, now that its size is known
+ *
+ **/
+void CheckpointWriter::endSection()
+{
+	unsigned int size = (unsigned int)(m_data.size() - m_section - sizeof(unsigned int));
+	memcpy(&m_data[m_section], &size, sizeof(size));
+}
+
+/** @brief CheckpointWriter::writeBytes - Add some bytes to the section
+ *
+ **/
+void CheckpointWriter::writeBytes(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	m_data.insert(m_data.end(), bytes, bytes + size);
+}
+
+/** @brief CheckpointWriter::save - Write everything to a file
+ *
+ * @param char path - the file; an existing one is replaced
+ * @return bool - false if the file couldn't be written
+ *
+ **/
+bool CheckpointWriter::save(const char* path) const
+{
+	FILE* file = fopen(path, "wb");
+	if(!file)
+		return false;
+	bool ok = (fwrite(m_data.data(), 1, m_data.size(), file) == m_data.size());
+	if(fclose(file) != 0)
+		ok = false;
+	return ok;
+}
+
+/** @brief CheckpointReader::load - Read a checkpoint file into memory
+ *
+ * @param char path
+ * @return bool - false if the file couldn't be read, or isn't a checkpoint
+ *
+ **/
+bool CheckpointReader::load(const char* path)
+{
+	m_data.clear();
+	m_pos = m_end = 0;
+	FILE* file = fopen(path, "rb");
+	if(!file)
+		return false;
+	unsigned char buffer[1 << 16];
+	size_t count;
+	while((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		m_data.insert(m_data.end(), buffer, buffer + count);
+	bool ok = !ferror(file);
+	fclose(file);
+
+	unsigned int version = 0;
+	if(ok && m_data.size() >= HEADER_SIZE)
+		memcpy(&version, &m_data[sizeof(CHECKPOINT_MAGIC)], sizeof(version));
+	if(!ok || m_data.size() < HEADER_SIZE ||
+	   memcmp(&m_data[0], CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || version != CHECKPOINT_VERSION)
+	{
+		m_data.clear();
+		return false;
+	}
+	return true;
+}
+
+/** @brief CheckpointReader::findSection - Find a section, and start reading from the
+ *                                         beginning of it
+ *
+ * @param char tag - the section's name, four letters long
+ * @return bool - false if the checkpoint has no such section
+ *
+ **/
+bool CheckpointReader::findSection(const char* tag)
+{
+	m_pos = m_end = 0;
+	size_t pos = HEADER_SIZE;
+	while(pos + SECTION_HEADER_SIZE <= m_data.size())
+	{
+		unsigned int size;
+		memcpy(&size, &m_data[pos + 4], sizeof(size));
+		size_t begin = pos + SECTION_HEADER_SIZE;
+		// a section cut short means the file was; nothing after it can be trusted
+		if(size > m_data.size() - begin)
+			return false;
+		if(memcmp(&m_data[pos], tag, 4) == 0)
+		{
+			m_pos = begin;
+			m_end = begin + size;
+			return true;
+		}
+		pos = begin + size;
+	}
+	return false;
+}
+
+/** @brief CheckpointReader::readBytes - Read the next few bytes of the section
+ *
+ * @param void data - where to copy them to
+ * @param size_t size - how many bytes to read
+ * @return bool - false if the section doesn't have that many left
+ *
+ **/
+bool CheckpointReader::readBytes(void* data, size_t size)
+{
+	if(size > m_end - m_pos)
+	{
+		// nothing more comes out of this section
+		m_pos = m_end;
+		return false;
+	}
+	if(size > 0)
+		memcpy(data, &m_data[m_pos], size);
+	m_pos += size;
+	return true;
+}
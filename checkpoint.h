@@ -0,0 +1,73 @@
+// checkpoint.h
+
+// Saving the whole simulation to a file, and loading it back, so a run
+// can be stopped and picked up again exactly where it was.
+//
+// A checkpoint file is a header ("BOIDCKPT" and a version), then a list
+// of sections, each a four letter tag, its size in bytes, and its
+// contents. Each part of the program writes its own section (the swarm,
+// the simulation's globals, the modeler's controls and plant, ...), and
+// finds it again by its tag when loading, so a section a reader doesn't
+// know about is just skipped, and a missing one leaves that part as it
+// was. Values are written as their raw bytes, in the machine's own byte
+// order.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <vector>
+#include <cstddef>
+
+static const unsigned int CHECKPOINT_VERSION = 1;
+
+class CheckpointWriter
+{
+public:
+	CheckpointWriter();
+
+	// everything written between these goes in the section
+	void beginSection(const char* tag);
+	void endSection();
+
+	template<class T>
+	void write(const T& value) {writeBytes(&value, sizeof(T));}
+	template<class T>
+	void writeArray(const T* values, size_t count) {writeBytes(values, count * sizeof(T));}
+	void writeBytes(const void* data, size_t size);
+
+	bool save(const char* path) const;
+
+private:
+	std::vector<unsigned char> m_data;
+	// where the open section's size goes
+	size_t m_section;
+};
+
+class CheckpointReader
+{
+public:
+	CheckpointReader() : m_pos(0), m_end(0) {}
+
+	bool load(const char* path);
+
+	// start reading a section from its beginning
+	bool findSection(const char* tag);
+
+	// these return false, and leave the value alone, past the end of the section
+	template<class T>
+	bool read(T& value) {return readBytes(&value, sizeof(T));}
+	template<class T>
+	bool readArray(T* values, size_t count) {return readBytes(values, count * sizeof(T));}
+	bool readBytes(void* data, size_t size);
+
+	// how much of the section hasn't been read yet
+	size_t getBytesLeft() const {return m_end - m_pos;}
+
+private:
+	std::vector<unsigned char> m_data;
+	// the part of the section not read yet
+	size_t m_pos;
+	size_t m_end;
+};
+
+#endif
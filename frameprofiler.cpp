@@ -0,0 +1,170 @@
+#include "frameprofiler.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/** @brief FrameProfiler::FrameProfiler - Make a profiler for a set of stages
+ *
+ * @param char stage_names - a name for each stage, kept (not copied) for reports
+ * @param int num_stages - how many stages there are
+ * @param int capacity - how many samples to keep, rounded up to a power of 2
+ *
+ **/
+FrameProfiler::FrameProfiler(const char* const* stage_names, int num_stages, int capacity)
+	: m_stage_names(stage_names, stage_names + num_stages), m_next(0), m_frame(0)
+{
+	unsigned int size = 2;
+	while(size < (unsigned int)max(capacity, 2))
+		size *= 2;
+	m_entries = new Entry[size];
+	m_mask = size - 1;
+	for(unsigned int e = 0; e < size; e++)
+		m_entries[e].sequence.store(0);
+}
+
+FrameProfiler::~FrameProfiler()
+{
+	delete[] m_entries;
+}
+
+/** @brief FrameProfiler::addSample - Add how long a stage took, writing over the oldest
+ *                                    sample once the buffer is full
+ *
+ * @param int stage
+ * @param double seconds
+ *
+ **/
+void FrameProfiler::addSample(int stage, double seconds)
+{
+	unsigned long long claim = m_next.fetch_add(1);
+	Entry& entry = m_entries[claim & m_mask];
+	// readers skip the entry until it's stamped again
+	entry.sequence.store(0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	entry.frame.store(m_frame.load(memory_order_relaxed), memory_order_relaxed);
+	entry.stage.store(stage, memory_order_relaxed);
+	entry.nanoseconds.store((long long)(seconds * 1e9 + 0.5), memory_order_relaxed);
+	entry.sequence.store(claim + 1, memory_order_release);
+}
+
+/** @brief FrameProfiler::readSamples - Copy out every sample in the buffer that can be
+ *                                      read whole, oldest first
+ *
+ * @param vector<Sample> samples - filled in with the samples
+ *
+ **/
+void FrameProfiler::readSamples(vector<Sample>& samples) const
+{
+	samples.clear();
+	for(unsigned int e = 0; e <= m_mask; e++)
+	{
+		const Entry& entry = m_entries[e];
+		Sample sample;
+		sample.sequence = entry.sequence.load(memory_order_acquire);
+		if(sample.sequence == 0)
+			continue;
+		sample.frame = entry.frame.load(memory_order_relaxed);
+		sample.stage = entry.stage.load(memory_order_relaxed);
+		sample.nanoseconds = entry.nanoseconds.load(memory_order_relaxed);
+		// written over while it was copied
+		atomic_thread_fence(memory_order_acquire);
+		if(entry.sequence.load(memory_order_relaxed) != sample.sequence)
+			continue;
+		samples.push_back(sample);
+	}
+	sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b)
+	{
+		return a.sequence < b.sequence;
+	});
+}
+
+/** @brief getPercentile - Get a percentile of some sorted values (the nearest rank)
+ *
+ **/
+static double getPercentile(const vector<double>& sorted, double percent)
+{
+	int rank = int(ceil(percent / 100.0 * sorted.size()));
+	return sorted[min(max(rank, 1), int(sorted.size())) - 1];
+}
+
+/** @brief FrameProfiler::getStats - Sum up how long a stage took over the last few frames
+ *
+ * @param int stage
+ * @param int window - how many frames back to look, the current one included
+ *                     (only as far as the buffer still holds)
+ * @return StageStats - all zero if the stage has no samples in the window
+ *
+ **/
+StageStats FrameProfiler::getStats(int stage, int window) const
+{
+	vector<Sample> samples;
+	readSamples(samples);
+	unsigned int frame = m_frame.load();
+	vector<double> seconds;
+	for(size_t s = 0; s < samples.size(); s++)
+	{
+		if(samples[s].stage == stage && frame - samples[s].frame < (unsigned int)window)
+			seconds.push_back(samples[s].nanoseconds * 1e-9);
+	}
+
+	StageStats stats = {0, 0.0, 0.0, 0.0, 0.0};
+	if(seconds.empty())
+		return stats;
+	sort(seconds.begin(), seconds.end());
+	double total = 0.0;
+	for(size_t s = 0; s < seconds.size(); s++)
+		total += seconds[s];
+	stats.count = int(seconds.size());
+	stats.min = seconds[0];
+	stats.mean = total / seconds.size();
+	stats.p95 = getPercentile(seconds, 95.0);
+	stats.p99 = getPercentile(seconds, 99.0);
+	return stats;
+}
+
+/** @brief FrameProfiler::printReport - Print every stage's timings over the last few
+ *                                      frames as a table, in milliseconds
+ *
+ * @param FILE out
+ * @param int window - how many frames back to look (see getStats())
+ *
+ **/
+void FrameProfiler::printReport(FILE* out, int window) const
+{
+	fprintf(out, "%-14s %8s %10s %10s %10s %10s\n", "stage", "samples", "min ms", "mean ms", "p95 ms", "p99 ms");
+	for(int stage = 0; stage < getStageCount(); stage++)
+	{
+		StageStats stats = getStats(stage, window);
+		fprintf(out, "%-14s %8d %10.3f %10.3f %10.3f %10.3f\n", getStageName(stage), stats.count,
+		        stats.min * 1000.0, stats.mean * 1000.0, stats.p95 * 1000.0, stats.p99 * 1000.0);
+	}
+}
+
+/** @brief FrameProfiler::writeCSV - Write every sample in the buffer to a CSV file,
+ *                                   oldest first
+ *
+ * @param char path - the file; an existing one is replaced
+ * @return bool - false if the file couldn't be written
+ *
+ **/
+bool FrameProfiler::writeCSV(const char* path) const
+{
+	FILE* out = fopen(path, "w");
+	if(!out)
+		return false;
+	vector<Sample> samples;
+	readSamples(samples);
+	fprintf(out, "sample,frame,stage,ms\n");
+	for(size_t s = 0; s < samples.size(); s++)
+	{
+		int stage = samples[s].stage;
+		fprintf(out, "%llu,%u,%s,%.6f\n", samples[s].sequence - 1, samples[s].frame,
+		        (stage >= 0 && stage < getStageCount()) ? getStageName(stage) : "?",
+		        samples[s].nanoseconds * 1e-6);
+	}
+	bool ok = !ferror(out);
+	if(fclose(out) != 0)
+		ok = false;
+	return ok;
+}
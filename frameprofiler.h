@@ -0,0 +1,108 @@
+// frameprofiler.h
+
+// Times the stages of each frame (or each step), to find out which one a
+// slow frame spent its time in. A StageTimer around a stage adds one
+// sample, the stage and how long it took, to the profiler when it goes
+// out of scope.
+//
+// Samples go into a ring buffer that always holds the most recent ones,
+// the oldest being written over as new ones come in. Adding a sample
+// takes no lock: each writer claims the next entry with an atomic
+// counter, and stamps the entry with the claim once it's filled in. A
+// reader copies an entry and checks the stamp is the same before and
+// after, so an entry written over while it's being read is skipped
+// rather than read half old and half new. Any thread can add samples
+// while another reads them.
+
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// a stage's timings over the last few frames, in seconds
+struct StageStats
+{
+	int count;
+	double min;
+	double mean;
+	double p95;
+	double p99;
+};
+
+class FrameProfiler
+{
+public:
+	// how many samples the buffer keeps, unless told otherwise
+	static const int DEFAULT_CAPACITY = 4096;
+
+	FrameProfiler(const char* const* stage_names, int num_stages, int capacity = DEFAULT_CAPACITY);
+	~FrameProfiler();
+
+	int getStageCount() const {return int(m_stage_names.size());}
+	const char* getStageName(int stage) const {return m_stage_names[stage];}
+
+	void addSample(int stage, double seconds);
+	// samples added from now on belong to the next frame
+	void nextFrame() {m_frame++;}
+	unsigned int getFrame() const {return m_frame;}
+
+	StageStats getStats(int stage, int window) const;
+	void printReport(FILE* out, int window) const;
+	bool writeCSV(const char* path) const;
+
+private:
+	FrameProfiler(const FrameProfiler&);
+	FrameProfiler& operator=(const FrameProfiler&);
+
+	struct Entry
+	{
+		// the claim the entry was last written for, plus 1; 0 while it's being written
+		std::atomic<unsigned long long> sequence;
+		std::atomic<unsigned int> frame;
+		std::atomic<int> stage;
+		std::atomic<long long> nanoseconds;
+	};
+
+	// a copy of an entry that was read whole
+	struct Sample
+	{
+		unsigned long long sequence;
+		unsigned int frame;
+		int stage;
+		long long nanoseconds;
+	};
+
+	void readSamples(std::vector<Sample>& samples) const;
+
+	std::vector<const char*> m_stage_names;
+	Entry* m_entries;
+	unsigned int m_mask;
+	std::atomic<unsigned long long> m_next;
+	std::atomic<unsigned int> m_frame;
+};
+
+// adds a sample for a stage, timed from when it's made until it goes out of scope
+class StageTimer
+{
+public:
+	StageTimer(FrameProfiler& profiler, int stage)
+		: m_profiler(profiler), m_stage(stage), m_start(std::chrono::steady_clock::now()) {}
+	~StageTimer()
+	{
+		m_profiler.addSample(m_stage,
+		                     std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+	}
+
+private:
+	StageTimer(const StageTimer&);
+	StageTimer& operator=(const StageTimer&);
+
+	FrameProfiler& m_profiler;
+	int m_stage;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+#endif
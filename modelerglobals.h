@@ -13,7 +13,18 @@ enum SampleModelControls
 	XPOS, YPOS, ZPOS, HEIGHT, ROTATE, R_DEPTH, B_ANGLE,  B_BEND_ANGLE, SYMMETRY, 
 	S_ANGLE, B_COLOR, L_COLOR, B_WIDTH, L_SIZE, STOCH, SHOW_DIR, PERCEPTION,
 	FLOCK_D, ADD_WIND, CIRCLE_PLANT, FLOCK_RANGE, FLOCK_SPEED, BOID_COLOR, CAN_PERCH, 
-	FRAMERATE, ALT_PLANT, NUMCONTROLS
+	FRAMERATE, ALT_PLANT, NEIGHBOR_SEARCH, SIMD_KERNEL, THREADS, NEAREST, THETA, SKIN, SORT_INTERVAL,
+	BOID_COUNT, SPECIES_COUNT, AVOID_D,
+	// the settings of species 1 and up, three to a species (species 0 uses
+	// PERCEPTION, FLOCK_D and FLOCK_SPEED)
+	S1_PERCEPTION, S1_FLOCK_D, S1_FLOCK_SPEED,
+	S2_PERCEPTION, S2_FLOCK_D, S2_FLOCK_SPEED,
+	S3_PERCEPTION, S3_FLOCK_D, S3_FLOCK_SPEED,
+	PLANT_AVOID_D, PERCH_ON_PLANT,
+	RECORD_TRAJECTORY, REPLAY, REPLAY_POSITION, REPLAY_SPEED,
+	SAVE_CHECKPOINT, LOAD_CHECKPOINT,
+	PROFILE_REPORT, DUMP_PROFILE,
+	NUMCONTROLS
 };
 
 // Colors
@@ -0,0 +1,64 @@
+#include "neighborindex.h"
+#include <algorithm>
+
+using namespace std;
+
+/** @brief NeighborIndex::mergeRuns - Merge sorted runs of boid indices into one
+ *                                    sorted list
+ *
+ * The runs are merged pairwise until there's a single run left.
+ *
+ * @param vector<int> nearby - holds the runs, back to back; set to the merged list
+ * @param vector<int> scratch - working space for the merge
+ * @param int* runs - where each run starts in nearby, followed by the end of the
+ *                    last run; this is overwritten
+ * @param int num_runs - how many runs there are
+ *
+ **/
+void NeighborIndex::mergeRuns(vector<int>& nearby, vector<int>& scratch, int* runs, int num_runs)
+{
+	scratch.resize(nearby.size());
+	while(num_runs > 1)
+	{
+		int merged = 0;
+		for(int r = 0; r < num_runs; r += 2)
+		{
+			int start = runs[r];
+			int mid = runs[min(r + 1, num_runs)];
+			int end = runs[min(r + 2, num_runs)];
+			mergeRun(&nearby[0] + start, &nearby[0] + mid, &nearby[0] + end, &scratch[0] + start);
+			runs[merged++] = start;
+		}
+		runs[merged] = runs[num_runs];
+		num_runs = merged;
+		nearby.swap(scratch);
+	}
+}
+
+/** @brief NeighborIndex::mergeRun - Merge two sorted runs of boid indices
+ *
+ * The runs come from different parts of space, so which one the next index comes from
+ * is essentially random; picking it without branching keeps the merge from
+ * stalling on mispredictions.
+ *
+ * @param int* a - the start of the first run
+ * @param int* b - the start of the second run, which is also the end of the first
+ * @param int* end - the end of the second run
+ * @param int* out - where to write the merged run
+ *
+ **/
+void NeighborIndex::mergeRun(const int* a, const int* b, const int* end, int* out)
+{
+	const int* a_end = b;
+	while(a < a_end && b < end)
+	{
+		int take_b = *b < *a;
+		*out++ = take_b ? *b : *a;
+		a += 1 - take_b;
+		b += take_b;
+	}
+	while(a < a_end)
+		*out++ = *a++;
+	while(b < end)
+		*out++ = *b++;
+}
@@ -0,0 +1,34 @@
+// neighborindex.h
+
+// The interface shared by the structures that speed up the boids'
+// neighbor queries (BoidGrid, BoidOctree). Each one is rebuilt from the
+// swarm at the start of a step, and then answers "which boids are within
+// this distance of here" for every boid in the flock.
+
+#ifndef NEIGHBORINDEX_H
+#define NEIGHBORINDEX_H
+
+#include "vec.h"
+#include <vector>
+
+class BoidSwarm;
+
+class NeighborIndex
+{
+public:
+	virtual ~NeighborIndex() {}
+
+	// distance is the farthest any later query will search
+	virtual void build(const BoidSwarm& boids, double distance) = 0;
+
+	// fills nearby with the indices of the boids within distance of pos,
+	// in swarm order; scratch is working space the search may use
+	virtual void getNearbyBoids(const Vec3d& pos, double distance, std::vector<int>& nearby,
+	                            std::vector<int>& scratch) const = 0;
+
+protected:
+	static void mergeRuns(std::vector<int>& nearby, std::vector<int>& scratch, int* runs, int num_runs);
+	static void mergeRun(const int* a, const int* b, const int* end, int* out);
+};
+
+#endif
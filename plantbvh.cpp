@@ -0,0 +1,214 @@
+#include "plantbvh.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/** @brief getCapsuleDistance - Get how far a position is from a capsule's surface
+ *
+ * @param PlantCapsule capsule
+ * @param Vec3d pos
+ * @param double away - set to a unit vector pointing from the capsule's segment to pos
+ * @return double - the distance from the surface, below 0 if pos is inside
+ *
+ **/
+double getCapsuleDistance(const PlantCapsule& capsule, const Vec3d& pos, double away[3])
+{
+	// the nearest point on the segment, as a fraction of the way from a to b
+	double ab[3], ap[3];
+	double ab2 = 0.0, dot = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		ab[k] = capsule.b[k] - capsule.a[k];
+		ap[k] = pos[k] - capsule.a[k];
+		ab2 += ab[k] * ab[k];
+		dot += ab[k] * ap[k];
+	}
+	double t = (ab2 > 0.0) ? min(max(dot / ab2, 0.0), 1.0) : 0.0;
+
+	double length2 = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		away[k] = ap[k] - t * ab[k];
+		length2 += away[k] * away[k];
+	}
+	double length = sqrt(length2);
+	if(length > 0.0)
+	{
+		for(int k = 0; k < 3; k++)
+			away[k] /= length;
+	}
+	else
+	{
+		// right on the segment; any way out will do, so go up
+		away[0] = 0.0;
+		away[1] = 1.0;
+		away[2] = 0.0;
+	}
+	return length - capsule.radius;
+}
+
+/** @brief PlantBVH::build - Make a fresh tree over the plant's capsules
+ *
+ * @param vector<PlantCapsule> capsules
+ *
+ **/
+void PlantBVH::build(const vector<PlantCapsule>& capsules)
+{
+	m_capsules = capsules;
+	m_nodes.clear();
+	m_order.resize(m_capsules.size());
+	for(int i = 0; i < int(m_order.size()); i++)
+		m_order[i] = i;
+	if(m_capsules.empty())
+		return;
+
+	addNode(0, int(m_order.size()));
+	split(0);
+}
+
+/** @brief PlantBVH::addNode - Add a leaf holding some of the capsules, sized to fit them
+ *
+ * @param int begin - the node's first capsule
+ * @param int end - one past the node's last capsule
+ * @return int - the new node
+ *
+ **/
+int PlantBVH::addNode(int begin, int end)
+{
+	Node node;
+	node.begin = begin;
+	node.end = end;
+	node.first_child = -1;
+	for(int k = 0; k < 3; k++)
+	{
+		node.min[k] = HUGE_VAL;
+		node.max[k] = -HUGE_VAL;
+	}
+	for(int i = begin; i < end; i++)
+	{
+		const PlantCapsule& c = m_capsules[m_order[i]];
+		for(int k = 0; k < 3; k++)
+		{
+			node.min[k] = min(node.min[k], min(c.a[k], c.b[k]) - c.radius);
+			node.max[k] = max(node.max[k], max(c.a[k], c.b[k]) + c.radius);
+		}
+	}
+	m_nodes.push_back(node);
+	return int(m_nodes.size()) - 1;
+}
+
+/** @brief PlantBVH::split - Split a node in two at the middle capsule along its longest
+ *                           side, and the halves again, until the leaves are small
+ *
+ * @param int node
+ *
+ **/
+void PlantBVH::split(int node)
+{
+	int begin = m_nodes[node].begin;
+	int end = m_nodes[node].end;
+	if(end - begin <= LEAF_SIZE)
+		return;
+
+	int axis = 0;
+	for(int k = 1; k < 3; k++)
+	{
+		if(m_nodes[node].max[k] - m_nodes[node].min[k] > m_nodes[node].max[axis] - m_nodes[node].min[axis])
+			axis = k;
+	}
+	// half the capsules on each side, by the middle of each capsule
+	int middle = (begin + end) / 2;
+	const vector<PlantCapsule>& capsules = m_capsules;
+	nth_element(m_order.begin() + begin, m_order.begin() + middle, m_order.begin() + end,
+	            [&](int i, int j)
+	{
+		return capsules[i].a[axis] + capsules[i].b[axis] < capsules[j].a[axis] + capsules[j].b[axis];
+	});
+
+	// the children are added together, so they sit next to each other
+	int first_child = addNode(begin, middle);
+	addNode(middle, end);
+	m_nodes[node].first_child = first_child;
+	split(first_child);
+	split(first_child + 1);
+}
+
+/** @brief PlantBVH::distanceToBox - Get the distance from a position to the nearest
+ *                                   point of a node's bounds (0 inside them)
+ *
+ **/
+double PlantBVH::distanceToBox(const Node& node, const Vec3d& pos)
+{
+	double d2 = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		double d = 0.0;
+		if(pos[k] < node.min[k])
+			d = node.min[k] - pos[k];
+		else if(pos[k] > node.max[k])
+			d = pos[k] - node.max[k];
+		d2 += d * d;
+	}
+	return sqrt(d2);
+}
+
+/** @brief PlantBVH::findNearest - Find the part of the plant nearest to a position
+ *
+ * A node's box holds its capsules whole, so nothing in it can be nearer than
+ * the box is. Nodes farther away than the nearest capsule found so far are
+ * skipped, and the nearer child of each node is opened first so that capsule
+ * is found early.
+ *
+ * @param Vec3d pos - the position to search around
+ * @param double max_distance - how far from a capsule's surface pos can be and
+ *                              still be found
+ * @param PlantHit hit - set to the nearest capsule, if one is found
+ * @return bool - whether any capsule is within max_distance
+ *
+ **/
+bool PlantBVH::findNearest(const Vec3d& pos, double max_distance, PlantHit& hit) const
+{
+	if(m_nodes.empty())
+		return false;
+
+	double best = max_distance;
+	bool found = false;
+	int stack[64];
+	int depth = 0;
+	stack[depth++] = 0;
+	while(depth > 0)
+	{
+		const Node& node = m_nodes[stack[--depth]];
+		// inside some capsule already, only boxes around pos can hold one it's deeper in
+		if(distanceToBox(node, pos) > max(best, 0.0))
+			continue;
+		if(node.first_child < 0)
+		{
+			for(int i = node.begin; i < node.end; i++)
+			{
+				double away[3];
+				double distance = getCapsuleDistance(m_capsules[m_order[i]], pos, away);
+				if(distance <= best)
+				{
+					best = distance;
+					found = true;
+					hit.distance = distance;
+					hit.away[0] = away[0];
+					hit.away[1] = away[1];
+					hit.away[2] = away[2];
+					hit.capsule = m_order[i];
+				}
+			}
+			continue;
+		}
+		// push the farther child first, so the nearer one is opened first
+		int near_child = node.first_child;
+		int far_child = node.first_child + 1;
+		if(distanceToBox(m_nodes[far_child], pos) < distanceToBox(m_nodes[near_child], pos))
+			swap(near_child, far_child);
+		stack[depth++] = far_child;
+		stack[depth++] = near_child;
+	}
+	return found;
+}
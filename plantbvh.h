@@ -0,0 +1,60 @@
+// plantbvh.h
+
+// A bounding volume hierarchy over the plant's branches and leaves (see
+// plantturtle.h), so a boid can find the nearest part of the plant
+// without testing every capsule. Each node holds a box around its
+// capsules and is split in two along its longest side, so a query only
+// opens the few nodes whose boxes are closer than the nearest capsule
+// found so far, and costs about log(capsules) instead of all of them.
+
+#ifndef PLANTBVH_H
+#define PLANTBVH_H
+
+#include "plantturtle.h"
+#include "vec.h"
+#include <vector>
+
+// the nearest point of the plant to a position
+struct PlantHit
+{
+	double distance;  // from the capsule's surface (below 0 inside it)
+	double away[3];   // unit vector pointing from the capsule out to the position
+	int capsule;      // which capsule, in the order they were built from
+};
+
+extern double getCapsuleDistance(const PlantCapsule& capsule, const Vec3d& pos, double away[3]);
+
+class PlantBVH
+{
+public:
+	PlantBVH() {}
+
+	void build(const std::vector<PlantCapsule>& capsules);
+	bool empty() const {return m_capsules.empty();}
+	int getCapsuleCount() const {return int(m_capsules.size());}
+	const std::vector<PlantCapsule>& getCapsules() const {return m_capsules;}
+
+	bool findNearest(const Vec3d& pos, double max_distance, PlantHit& hit) const;
+
+private:
+	// a node splits when it holds more capsules than this
+	static const int LEAF_SIZE = 4;
+
+	struct Node
+	{
+		double min[3], max[3];  // bounds of the node's capsules, radius included
+		int begin, end;         // the node's capsules in m_order
+		int first_child;        // the first of 2 children, or -1 for a leaf
+	};
+
+	int addNode(int begin, int end);
+	void split(int node);
+	static double distanceToBox(const Node& node, const Vec3d& pos);
+
+	std::vector<PlantCapsule> m_capsules;
+	// the capsules, in the order the tree's leaves hold them
+	std::vector<int> m_order;
+	std::vector<Node> m_nodes;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "plantsdf.h"
+#include "plantbvh.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/** @brief PlantSDF::build - Sample the plant's distance field on a fresh grid
+ *
+ * @param PlantBVH plant - the plant's branches and leaves
+ * @param double cell_size - the distance between voxels (made bigger if the grid
+ *                           would have more than MAX_VOXELS)
+ * @param double max_distance - how far from the plant distances are kept; the grid
+ *                              reaches this far past the plant on every side
+ *
+ **/
+void PlantSDF::build(const PlantBVH& plant, double cell_size, double max_distance)
+{
+	clear();
+	if(plant.empty() || cell_size <= 0.0)
+		return;
+
+	// the bounds of the plant, and max_distance around them
+	double low[3], high[3];
+	for(int k = 0; k < 3; k++)
+	{
+		low[k] = HUGE_VAL;
+		high[k] = -HUGE_VAL;
+	}
+	const vector<PlantCapsule>& capsules = plant.getCapsules();
+	for(size_t c = 0; c < capsules.size(); c++)
+	{
+		for(int k = 0; k < 3; k++)
+		{
+			low[k] = min(low[k], min(capsules[c].a[k], capsules[c].b[k]) - capsules[c].radius);
+			high[k] = max(high[k], max(capsules[c].a[k], capsules[c].b[k]) + capsules[c].radius);
+		}
+	}
+
+	m_max_distance = max_distance;
+	m_cell_size = cell_size;
+	for(;;)
+	{
+		double voxels = 1.0;
+		for(int k = 0; k < 3; k++)
+		{
+			m_origin[k] = low[k] - max_distance;
+			m_size[k] = max(int(ceil((high[k] - low[k] + 2.0 * max_distance) / m_cell_size)) + 1, 2);
+			voxels *= m_size[k];
+		}
+		if(voxels <= MAX_VOXELS)
+			break;
+		m_cell_size *= 1.25;
+	}
+
+	m_distances.resize(size_t(m_size[0]) * m_size[1] * m_size[2]);
+	size_t v = 0;
+	for(int z = 0; z < m_size[2]; z++)
+		for(int y = 0; y < m_size[1]; y++)
+			for(int x = 0; x < m_size[0]; x++)
+			{
+				Vec3d pos(m_origin[0] + x * m_cell_size, m_origin[1] + y * m_cell_size, m_origin[2] + z * m_cell_size);
+				// voxels far from the plant give up their search early
+				PlantHit hit;
+				m_distances[v++] = float(plant.findNearest(pos, max_distance, hit) ? hit.distance : max_distance);
+			}
+}
+
+/** @brief PlantSDF::clear - Forget the field, so every position is far from the plant
+ *
+ **/
+void PlantSDF::clear()
+{
+	m_distances.clear();
+	m_size[0] = m_size[1] = m_size[2] = 0;
+}
+
+/** @brief PlantSDF::getCell - Find the voxels around a position
+ *
+ * @param Vec3d pos
+ * @param int cell - set to the voxel at the low corner of the cell holding pos
+ * @param double t - set to how far across the cell pos is on each axis, 0 to 1
+ * @return bool - false if pos is outside the grid
+ *
+ **/
+bool PlantSDF::getCell(const Vec3d& pos, int cell[3], double t[3]) const
+{
+	if(m_distances.empty())
+		return false;
+	for(int k = 0; k < 3; k++)
+	{
+		double f = (pos[k] - m_origin[k]) / m_cell_size;
+		if(!(f >= 0.0 && f <= m_size[k] - 1))
+			return false;
+		cell[k] = min(int(f), m_size[k] - 2);
+		t[k] = f - cell[k];
+	}
+	return true;
+}
+
+/** @brief PlantSDF::getDistance - Look up how far a position is from the plant
+ *
+ * @param Vec3d pos
+ * @return double - the distance from the nearest branch or leaf's surface (below 0
+ *                  inside it), or the max distance if pos is farther than that
+ *
+ **/
+double PlantSDF::getDistance(const Vec3d& pos) const
+{
+	double gradient[3];
+	return getDistance(pos, gradient);
+}
+
+/** @brief PlantSDF::getDistance - Look up how far a position is from the plant, and
+ *                                 which way is away from it
+ *
+ * @param Vec3d pos
+ * @param double gradient - set to the unit vector the distance grows fastest along,
+ *                          pointing away from the plant (zero where the field is flat,
+ *                          beyond the max distance)
+ * @return double - the distance from the nearest branch or leaf's surface (below 0
+ *                  inside it), or the max distance if pos is farther than that
+ *
+ **/
+double PlantSDF::getDistance(const Vec3d& pos, double gradient[3]) const
+{
+	gradient[0] = gradient[1] = gradient[2] = 0.0;
+	int c[3];
+	double t[3];
+	if(!getCell(pos, c, t))
+		return m_max_distance;
+
+	// the eight voxels at the cell's corners
+	double v000 = getVoxel(c[0], c[1], c[2]);
+	double v100 = getVoxel(c[0] + 1, c[1], c[2]);
+	double v010 = getVoxel(c[0], c[1] + 1, c[2]);
+	double v110 = getVoxel(c[0] + 1, c[1] + 1, c[2]);
+	double v001 = getVoxel(c[0], c[1], c[2] + 1);
+	double v101 = getVoxel(c[0] + 1, c[1], c[2] + 1);
+	double v011 = getVoxel(c[0], c[1] + 1, c[2] + 1);
+	double v111 = getVoxel(c[0] + 1, c[1] + 1, c[2] + 1);
+
+	double sx = 1.0 - t[0], sy = 1.0 - t[1], sz = 1.0 - t[2];
+	double distance = ((v000 * sx + v100 * t[0]) * sy + (v010 * sx + v110 * t[0]) * t[1]) * sz +
+	                  ((v001 * sx + v101 * t[0]) * sy + (v011 * sx + v111 * t[0]) * t[1]) * t[2];
+
+	// the derivatives of the interpolation along each axis
+	gradient[0] = ((v100 - v000) * sy + (v110 - v010) * t[1]) * sz + ((v101 - v001) * sy + (v111 - v011) * t[1]) * t[2];
+	gradient[1] = ((v010 - v000) * sx + (v110 - v100) * t[0]) * sz + ((v011 - v001) * sx + (v111 - v101) * t[0]) * t[2];
+	gradient[2] = ((v001 - v000) * sx + (v101 - v100) * t[0]) * sy + ((v011 - v010) * sx + (v111 - v110) * t[0]) * t[1];
+	double length = sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+	if(length > 0.0)
+	{
+		for(int k = 0; k < 3; k++)
+			gradient[k] /= length;
+	}
+	return distance;
+}
@@ -0,0 +1,53 @@
+// plantsdf.h
+
+// A signed distance field of the plant: the distance from the nearest
+// branch or leaf (below 0 inside one), sampled on a grid of voxels around
+// the plant and filled in between by trilinear interpolation. Once it's
+// built, finding how far a boid is from the plant, and which way is
+// away from it, reads just the eight voxels around the boid, however many
+// branches the plant has. It's made from the plant's BVH (see plantbvh.h)
+// whenever the plant changes, which is the slow part; distances beyond
+// max_distance are all stored as max_distance, so only the voxels near
+// the plant cost much to fill in.
+
+#ifndef PLANTSDF_H
+#define PLANTSDF_H
+
+#include "vec.h"
+#include <vector>
+
+class PlantBVH;
+
+class PlantSDF
+{
+public:
+	PlantSDF() : m_cell_size(1.0), m_max_distance(0.0) {m_size[0] = m_size[1] = m_size[2] = 0;}
+
+	void build(const PlantBVH& plant, double cell_size, double max_distance);
+	void clear();
+	bool empty() const {return m_distances.empty();}
+
+	double getDistance(const Vec3d& pos) const;
+	double getDistance(const Vec3d& pos, double gradient[3]) const;
+
+	double getCellSize() const {return m_cell_size;}
+	double getMaxDistance() const {return m_max_distance;}
+	int getVoxelCount() const {return int(m_distances.size());}
+
+	// the grid is kept below this many voxels, by making them bigger
+	static const int MAX_VOXELS = 1 << 22;
+
+private:
+	bool getCell(const Vec3d& pos, int cell[3], double t[3]) const;
+	float getVoxel(int x, int y, int z) const
+		{return m_distances[(size_t(z) * m_size[1] + y) * m_size[0] + x];}
+
+	// the first voxel's position, and how many voxels there are on each axis
+	double m_origin[3];
+	int m_size[3];
+	double m_cell_size;
+	double m_max_distance;
+	std::vector<float> m_distances;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "plantturtle.h"
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+bool operator==(const PlantCapsule& a, const PlantCapsule& b)
+{
+	return memcmp(&a, &b, sizeof(PlantCapsule)) == 0;
+}
+
+bool operator!=(const PlantCapsule& a, const PlantCapsule& b)
+{
+	return !(a == b);
+}
+
+/** @brief PlantTurtle::reset - Put the turtle back at the origin, and forget its capsules
+ *
+ **/
+void PlantTurtle::reset()
+{
+	static const double identity[12] = {1, 0, 0, 0,
+	                                    0, 1, 0, 0,
+	                                    0, 0, 1, 0};
+	memcpy(m_transform.m, identity, sizeof(identity));
+	m_scale = 1.0;
+	m_stack.clear();
+	m_scale_stack.clear();
+	m_capsules.clear();
+}
+
+/** @brief PlantTurtle::multiply - Apply a transform before the turtle's own, like
+ *                                glMultMatrix()
+ *
+ * @param Transform t
+ *
+ **/
+void PlantTurtle::multiply(const Transform& t)
+{
+	const double* a = m_transform.m;
+	const double* b = t.m;
+	Transform result;
+	for(int row = 0; row < 3; row++)
+	{
+		for(int col = 0; col < 4; col++)
+		{
+			double sum = a[row * 4 + 0] * b[col] + a[row * 4 + 1] * b[4 + col] + a[row * 4 + 2] * b[8 + col];
+			// the implied bottom row of b is (0, 0, 0, 1)
+			if(col == 3)
+				sum += a[row * 4 + 3];
+			result.m[row * 4 + col] = sum;
+		}
+	}
+	m_transform = result;
+}
+
+/** @brief PlantTurtle::translate - Move the turtle along its own axes
+ *
+ **/
+void PlantTurtle::translate(double x, double y, double z)
+{
+	Transform t = {{1, 0, 0, x,
+	                0, 1, 0, y,
+	                0, 0, 1, z}};
+	multiply(t);
+}
+
+/** @brief PlantTurtle::rotate - Turn the turtle around an axis of its own
+ *
+ * @param double angle - in degrees, counterclockwise looking down the axis
+ * @param double x, y, z - the axis, which doesn't have to be unit length
+ *
+ **/
+void PlantTurtle::rotate(double angle, double x, double y, double z)
+{
+	double length = sqrt(x * x + y * y + z * z);
+	if(length == 0.0)
+		return;
+	x /= length;
+	y /= length;
+	z /= length;
+	double radians = angle * 3.141592653589793 / 180.0;
+	double c = cos(radians);
+	double s = sin(radians);
+	double k = 1.0 - c;
+	// the same matrix glRotated() makes
+	Transform t = {{x * x * k + c,     x * y * k - z * s, x * z * k + y * s, 0,
+	                y * x * k + z * s, y * y * k + c,     y * z * k - x * s, 0,
+	                z * x * k - y * s, z * y * k + x * s, z * z * k + c,     0}};
+	multiply(t);
+}
+
+/** @brief PlantTurtle::scale - Scale everything the turtle makes from here on
+ *
+ * @param double s - the same scale on every axis
+ *
+ **/
+void PlantTurtle::scale(double s)
+{
+	Transform t = {{s, 0, 0, 0,
+	                0, s, 0, 0,
+	                0, 0, s, 0}};
+	multiply(t);
+	m_scale *= s;
+}
+
+void PlantTurtle::pushMatrix()
+{
+	m_stack.push_back(m_transform);
+	m_scale_stack.push_back(m_scale);
+}
+
+void PlantTurtle::popMatrix()
+{
+	if(m_stack.empty())
+		return;
+	m_transform = m_stack.back();
+	m_scale = m_scale_stack.back();
+	m_stack.pop_back();
+	m_scale_stack.pop_back();
+}
+
+/** @brief PlantTurtle::transformPoint - Take a point from the turtle's axes to world
+ *                                      coordinates
+ *
+ **/
+void PlantTurtle::transformPoint(double x, double y, double z, double out[3]) const
+{
+	const double* m = m_transform.m;
+	for(int row = 0; row < 3; row++)
+		out[row] = m[row * 4 + 0] * x + m[row * 4 + 1] * y + m[row * 4 + 2] * z + m[row * 4 + 3];
+}
+
+/** @brief PlantTurtle::addCylinder - Add a branch from the turtle's position along its z axis
+ *
+ * The turtle doesn't move; like drawCylinder(), it has to be translated to
+ * the end of the branch afterwards.
+ *
+ * @param double height - the length of the branch
+ * @param double radius
+ *
+ **/
+void PlantTurtle::addCylinder(double height, double radius)
+{
+	PlantCapsule capsule;
+	transformPoint(0, 0, 0, capsule.a);
+	transformPoint(0, 0, height, capsule.b);
+	capsule.radius = radius * m_scale;
+	m_capsules.push_back(capsule);
+}
+
+/** @brief PlantTurtle::addSphere - Add a leaf at the turtle's position
+ *
+ * @param double radius
+ *
+ **/
+void PlantTurtle::addSphere(double radius)
+{
+	PlantCapsule capsule;
+	transformPoint(0, 0, 0, capsule.a);
+	transformPoint(0, 0, 0, capsule.b);
+	capsule.radius = radius * m_scale;
+	m_capsules.push_back(capsule);
+}
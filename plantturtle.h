@@ -0,0 +1,68 @@
+// plantturtle.h
+
+// Follows the plant's turtle as it's drawn, without OpenGL. Every
+// glTranslated(), glRotated() and glScaled() the plant is drawn with is
+// repeated here on a matrix of our own, with the same push and pop, and
+// every branch and leaf becomes a capsule (a segment with a radius) in
+// world coordinates. The boids use the capsules to steer around the
+// plant (see plantbvh.h), and the turtle can also be driven with no
+// window at all, to make a plant for the console tools.
+
+#ifndef PLANTTURTLE_H
+#define PLANTTURTLE_H
+
+#include <vector>
+
+// a branch or a leaf: every point within radius of the segment from a to b
+// (a leaf is a capsule with a == b)
+struct PlantCapsule
+{
+	double a[3];
+	double b[3];
+	double radius;
+};
+
+extern bool operator==(const PlantCapsule& a, const PlantCapsule& b);
+extern bool operator!=(const PlantCapsule& a, const PlantCapsule& b);
+
+class PlantTurtle
+{
+public:
+	PlantTurtle() {reset();}
+
+	// back to the origin, with no capsules
+	void reset();
+
+	// the same as the OpenGL calls of the same names (angles in degrees)
+	void translate(double x, double y, double z);
+	void rotate(double angle, double x, double y, double z);
+	void scale(double s);
+	void pushMatrix();
+	void popMatrix();
+
+	// a branch along the turtle's z axis from where it is (like drawCylinder()),
+	// and a leaf where it is (like drawSphere())
+	void addCylinder(double height, double radius);
+	void addSphere(double radius);
+
+	const std::vector<PlantCapsule>& getCapsules() const {return m_capsules;}
+
+private:
+	// an affine transform, as the top three rows of a 4x4 matrix in row-major order
+	struct Transform
+	{
+		double m[12];
+	};
+
+	void multiply(const Transform& t);
+	void transformPoint(double x, double y, double z, double out[3]) const;
+
+	Transform m_transform;
+	// the uniform scale in m_transform, to scale radii by
+	double m_scale;
+	std::vector<Transform> m_stack;
+	std::vector<double> m_scale_stack;
+	std::vector<PlantCapsule> m_capsules;
+};
+
+#endif
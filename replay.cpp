@@ -0,0 +1,144 @@
+#include "replay.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// the slots findSlots() keeps track of: a few times the frame's boid count,
+// so a flock that has shrunk since its biggest still has its slots matched
+static const long long MAX_SLOTS_PER_BOID = 4;
+static const long long MIN_SLOTS = 1024;
+
+/** @brief TrajectoryReplay::open - Start playing a recorded file, from its first frame
+ *
+ * @param char path
+ * @return bool - false if the file couldn't be read (see TrajectoryReader::open())
+ *
+ **/
+bool TrajectoryReplay::open(const char* path)
+{
+	close();
+	if(!m_reader.open(path))
+		return false;
+	seek(0.0);
+	return true;
+}
+
+/** @brief TrajectoryReplay::close - Stop playing, and let go of the file
+ *
+ **/
+void TrajectoryReplay::close()
+{
+	m_reader.close();
+	m_time = 0.0;
+	m_pos.clear();
+	m_vel.clear();
+	m_species.clear();
+	m_next_index.clear();
+	m_next_frame = -1;
+}
+
+/** @brief TrajectoryReplay::seek - Show the boids at a given time
+ *
+ * @param double time - the frame to show, or a fraction of the way between two;
+ *                      kept between the first and the last frame
+ *
+ **/
+void TrajectoryReplay::seek(double time)
+{
+	int frames = getFrameCount();
+	if(frames == 0)
+	{
+		m_time = 0.0;
+		m_pos.clear();
+		m_vel.clear();
+		m_species.clear();
+		return;
+	}
+	m_time = min(max(time, 0.0), double(frames - 1));
+
+	int frame = int(m_time);
+	double t = m_time - frame;
+	if(frame >= frames - 1)
+	{
+		frame = frames - 1;
+		t = 0.0;
+	}
+	if(t > 0.0)
+		findSlots(frame + 1);
+
+	int n = m_reader.getBoidCount(frame);
+	m_pos.resize(n);
+	m_vel.resize(n);
+	m_species.resize(n);
+	for(int i = 0; i < n; i++)
+	{
+		m_pos[i] = m_reader.getPosition(frame, i);
+		m_vel[i] = m_reader.getVelocity(frame, i);
+		m_species[i] = m_reader.getSpecies(frame, i);
+		if(t == 0.0)
+			continue;
+
+		int slot = m_reader.getSlot(frame, i);
+		int next = (slot >= 0 && slot < int(m_next_index.size())) ? m_next_index[slot] : -1;
+		if(next < 0)
+			continue;
+		Vec3d next_pos = m_reader.getPosition(frame + 1, next);
+		Vec3d next_vel = m_reader.getVelocity(frame + 1, next);
+		for(int k = 0; k < 3; k++)
+		{
+			m_pos[i][k] += (next_pos[k] - m_pos[i][k]) * t;
+			m_vel[i][k] += (next_vel[k] - m_vel[i][k]) * t;
+		}
+	}
+}
+
+/** @brief TrajectoryReplay::advance - Move the time along, going back around to the
+ *                                     start after the last frame
+ *
+ * @param double frames - how far to move; below 1 plays in slow motion
+ *
+ **/
+void TrajectoryReplay::advance(double frames)
+{
+	double length = getFrameCount() - 1;
+	if(length <= 0.0)
+	{
+		seek(0.0);
+		return;
+	}
+	double time = fmod(m_time + frames, length);
+	if(time < 0.0)
+		time += length;
+	seek(time);
+}
+
+/** @brief TrajectoryReplay::findSlots - Note where each slot's boid is in a frame, for
+ *                                       matching boids up with it
+ *
+ * A swarm reuses despawned boids' slots, so its slots stay below the most
+ * boids it has held at once. Slots far beyond the frame's boid count can
+ * only come from a damaged file; those boids aren't matched up (they jump
+ * from frame to frame) rather than growing the table without bound.
+ *
+ * @param int frame
+ *
+ **/
+void TrajectoryReplay::findSlots(int frame)
+{
+	if(frame == m_next_frame)
+		return;
+	m_next_frame = frame;
+	int n = m_reader.getBoidCount(frame);
+	long long max_slot = MAX_SLOTS_PER_BOID * (long long)n + MIN_SLOTS;
+	fill(m_next_index.begin(), m_next_index.end(), -1);
+	for(int i = 0; i < n; i++)
+	{
+		int slot = m_reader.getSlot(frame, i);
+		if(slot < 0 || slot >= max_slot)
+			continue;
+		if(slot >= int(m_next_index.size()))
+			m_next_index.resize(size_t(slot) + 1, -1);
+		m_next_index[slot] = i;
+	}
+}
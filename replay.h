@@ -0,0 +1,55 @@
+// replay.h
+
+// Plays back a recorded trajectory (see trajectory.h) in place of the
+// simulation. The replay keeps a time measured in frames, which can be
+// set to any frame straight from the file's index, or moved along a bit
+// at a time; between two frames each boid is placed part way from where
+// it was in the first to where it was in the second, so playing slower
+// than one frame per draw still moves smoothly. Boids are matched
+// between frames by their slots, since the swarm may have reordered them
+// in between; a boid that isn't in the next frame (it was despawned)
+// stays where it was in the first.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "trajectory.h"
+#include <vector>
+
+class TrajectoryReplay
+{
+public:
+	TrajectoryReplay() : m_time(0.0), m_next_frame(-1) {}
+
+	bool open(const char* path);
+	void close();
+	bool isOpen() const {return m_reader.isOpen();}
+	int getFrameCount() const {return m_reader.getFrameCount();}
+
+	// the frame being shown; between two frames, part way from one to the next
+	double getTime() const {return m_time;}
+	void seek(double time);
+	void advance(double frames);
+
+	// the boids at the current time
+	int size() const {return int(m_species.size());}
+	const Vec3d& getPosition(int i) const {return m_pos[i];}
+	const Vec3d& getVelocity(int i) const {return m_vel[i];}
+	int getSpecies(int i) const {return m_species[i];}
+
+private:
+	void findSlots(int frame);
+
+	TrajectoryReader m_reader;
+	double m_time;
+
+	std::vector<Vec3d> m_pos;
+	std::vector<Vec3d> m_vel;
+	std::vector<int> m_species;
+
+	// where each slot's boid is in m_next_frame, or -1 if it isn't there
+	std::vector<int> m_next_index;
+	int m_next_frame;
+};
+
+#endif
@@ -0,0 +1,74 @@
+// rng.h
+
+// Seeded random numbers for the simulation and the plants, in place of
+// the global rand(). Each user gets its own stream (the boids' starting
+// positions, the wind, each plant), so drawing numbers for one never
+// changes the numbers another one sees, and there's no shared state for
+// threads to fight over.
+//
+// The streams are counter based: the n-th number of a stream is just a
+// hash of the stream's key and n. A stream only has to remember how many
+// numbers it has handed out, and any number can be found without drawing
+// the ones before it.
+
+#ifndef RNG_H
+#define RNG_H
+
+// the streams a seed is split into
+enum RandomStreams
+{
+	STREAM_INIT = 0,   // the boids' starting positions and velocities
+	STREAM_WIND,       // when gusts start and how hard they blow
+	STREAM_PLANT       // the stochastic plant; more plants use STREAM_PLANT + 1, ...
+};
+
+class RandomStream
+{
+public:
+	RandomStream() {seed(1, 0);}
+	RandomStream(unsigned long long seed_value, unsigned int stream) {seed(seed_value, stream);}
+
+	/** @brief RandomStream::seed - Start the stream over
+	 *
+	 * @param unsigned long long seed_value - the seed for the whole run
+	 * @param unsigned int stream - which of the seed's streams this is
+	 *
+	 **/
+	void seed(unsigned long long seed_value, unsigned int stream)
+	{
+		m_key = mix(mix(seed_value) ^ (stream + 1ULL) * GOLDEN_GAMMA);
+		m_counter = 0;
+	}
+
+	// the n-th number of this stream
+	unsigned long long at(unsigned long long n) const {return mix(m_key + n * GOLDEN_GAMMA);}
+
+	unsigned long long next() {return at(m_counter++);}
+	// a number from 0 to n - 1
+	int nextInt(int n) {return int(next() % (unsigned long long)n);}
+	// a number from 0 up to (but not including) 1
+	double nextDouble() {return (next() >> 11) * (1.0 / 9007199254740992.0);}
+
+	// how many numbers have been handed out, for saving and restoring a stream
+	unsigned long long getCounter() const {return m_counter;}
+	void setCounter(unsigned long long counter) {m_counter = counter;}
+
+private:
+	static const unsigned long long GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+	/** @brief RandomStream::mix - Scramble the bits of a number (the SplitMix64
+	 *                             finalizer), so nearby inputs give unrelated outputs
+	 *
+	 **/
+	static unsigned long long mix(unsigned long long z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	unsigned long long m_key;
+	unsigned long long m_counter;
+};
+
+#endif
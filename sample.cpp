@@ -1,18 +1,64 @@
 #include "modelerview.h"
 #include "modelerapp.h"
 #include "modelerdraw.h"
-#include "boids.h"
+#include "boidsdraw.h"
+#include "plantbvh.h"
+#include "plantsdf.h"
+#include "replay.h"
+#include "checkpoint.h"
+#include "frameprofiler.h"
 #include <FL/gl.h>
+#include <cstdio>
 #include <string>
+#include <vector>
 
 #include "modelerglobals.h"
 
+// the seed for the boids and the stochastic plants; the same seed always
+// gives the same animation
+const unsigned long long RANDOM_SEED = 1;
+
+// the spacing of the plant's distance field, and how far from the plant it
+// reaches (as far as the plant avoid distance control goes)
+const double PLANT_SDF_CELL_SIZE = 0.1;
+const double PLANT_SDF_MAX_DISTANCE = 2.0;
+
+// where the boids are recorded to, and replayed from (see trajectory.h)
+const char* const TRAJECTORY_FILE = "boids.traj";
+// where the whole simulation is saved to and loaded from (see checkpoint.h)
+const char* const CHECKPOINT_FILE = "boids.ckpt";
+// where the profiler's samples are dumped to, and how many frames back its
+// report looks
+const char* const PROFILE_FILE = "profile.csv";
+const int PROFILE_WINDOW = 300;
+
+// the parts of a frame the profiler times
+enum ProfileStage
+{
+	PROFILE_FRAME,
+	PROFILE_GRAMMAR,
+	PROFILE_MOVE_BOIDS,
+	PROFILE_DRAW_BOIDS,
+	PROFILE_PLANT,
+	PROFILE_PLANT_INDEX,
+	NUM_PROFILE_STAGES
+};
+const char* const PROFILE_STAGE_NAMES[NUM_PROFILE_STAGES] =
+{
+	"frame", "grammar", "move boids", "draw boids", "plant", "plant index"
+};
+
 // To make a SampleModel, we inherit off of ModelerView
 class SampleModel : public ModelerView 
 {
 public:
     SampleModel(int x, int y, int w, int h, char *label) 
-        : ModelerView(x,y,w,h,label) 
+        : ModelerView(x,y,w,h,label),
+		  m_plant_rng(RANDOM_SEED, STREAM_PLANT),
+		  m_alt_plant_rng(RANDOM_SEED, STREAM_PLANT + 1),
+		  m_boids_seeded(false),
+		  m_replay_position(-1.0),
+		  m_profiler(PROFILE_STAGE_NAMES, NUM_PROFILE_STAGES)
 	{ 
 		m_framerate = 20;
 	}
@@ -21,11 +67,37 @@ public:
 	std::string generateGrammar(int);
 	std::string generateAltGrammar(int);
 private:
+	void drawPlant(const std::string& rules, RandomStream& rng, int branch_color, int leaf_color);
+	void turtleTranslate(double x, double y, double z);
+	void turtleRotate(double angle, double x, double y, double z);
+	void turtleScale(double s);
+	void turtlePush();
+	void turtlePop();
+	void drawBranch(double height, double width);
+	void drawLeaf(double size);
+	bool saveCheckpoint(const char* path);
+	bool loadCheckpoint(const char* path);
+
 	std::string m_rules;
 	std::string m_alt_rules;
 	int m_r_depth;
 	double m_framerate;
-	std::vector<Boid*> m_boids;
+	BoidSwarm m_boids;
+	// each plant's stochastic branches draw from their own stream
+	RandomStream m_plant_rng;
+	RandomStream m_alt_plant_rng;
+	bool m_boids_seeded;
+	// the plant as it was last drawn, for the boids to steer around
+	PlantTurtle m_turtle;
+	PlantBVH m_plant_bvh;
+	PlantSDF m_plant_sdf;
+	// the recording and the replay of the boids, and where the replay was
+	// when the position control was last set
+	TrajectoryRecorder m_recorder;
+	TrajectoryReplay m_replay;
+	double m_replay_position;
+	// how long each part of the last few thousand frames took
+	FrameProfiler m_profiler;
 };
 
 // We need to make a creator function, mostly because of
@@ -35,6 +107,42 @@ ModelerView* createSampleModel(int x, int y, int w, int h, char *label)
     return new SampleModel(x,y,w,h,label); 
 }
 
+/** @brief getSimParams - Read the boids' settings from the controls
+ *
+ * @return SimParams - the settings to run the next simulation step with
+ *
+ **/
+static SimParams getSimParams()
+{
+	SimParams params;
+	params.perception = VAL(PERCEPTION);
+	params.flock_d = VAL(FLOCK_D);
+	params.flock_range = VAL(FLOCK_RANGE);
+	params.flock_speed = VAL(FLOCK_SPEED);
+	params.circle_plant = (VAL(CIRCLE_PLANT) != 0);
+	params.can_perch = (VAL(CAN_PERCH) != 0);
+	params.add_wind = (VAL(ADD_WIND) != 0);
+	params.neighbor_search = int (VAL(NEIGHBOR_SEARCH) + 0.5);
+	params.nearest = int (VAL(NEAREST) + 0.5);
+	params.theta = VAL(THETA);
+	params.skin = VAL(SKIN);
+	params.sort_interval = int (VAL(SORT_INTERVAL) + 0.5);
+	params.num_species = int (VAL(SPECIES_COUNT) + 0.5);
+	for(int s = 0; s < MAX_SPECIES - 1; s++)
+	{
+		int first = S1_PERCEPTION + 3 * s;
+		params.species[s].perception = VAL(first);
+		params.species[s].flock_d = VAL(first + 1);
+		params.species[s].flock_speed = VAL(first + 2);
+	}
+	params.avoid_d = VAL(AVOID_D);
+	params.plant_avoid_d = VAL(PLANT_AVOID_D);
+	params.perch_on_plant = (VAL(PERCH_ON_PLANT) != 0);
+	params.simd = (VAL(SIMD_KERNEL) != 0);
+	params.threads = int (VAL(THREADS) + 0.5);
+	return params;
+}
+
 /** @brief SampleModel::draw() - Overridden draw call; draw our sample model
  *
  **/
@@ -58,11 +166,43 @@ void SampleModel::draw()
 	// projection matrix, don't bother with this ...
     ModelerView::draw();
 
+	// report on or dump the frames so far when asked, before this one starts
+	if(VAL(PROFILE_REPORT))
+	{
+		ModelerApplication::Instance()->SetControlValue(PROFILE_REPORT, 0);
+		printf("last %d frames:\n", PROFILE_WINDOW);
+		m_profiler.printReport(stdout, PROFILE_WINDOW);
+	}
+	if(VAL(DUMP_PROFILE))
+	{
+		ModelerApplication::Instance()->SetControlValue(DUMP_PROFILE, 0);
+		if(!m_profiler.writeCSV(PROFILE_FILE))
+			fprintf(stderr, "couldn't write %s\n", PROFILE_FILE);
+	}
+	m_profiler.nextFrame();
+	StageTimer frame_timer(m_profiler, PROFILE_FRAME);
+
+	// save or load the simulation when asked, before anything this frame reads
+	// the controls or moves the boids
+	if(VAL(SAVE_CHECKPOINT))
+	{
+		ModelerApplication::Instance()->SetControlValue(SAVE_CHECKPOINT, 0);
+		if(!saveCheckpoint(CHECKPOINT_FILE))
+			fprintf(stderr, "couldn't save %s\n", CHECKPOINT_FILE);
+	}
+	if(VAL(LOAD_CHECKPOINT))
+	{
+		if(!loadCheckpoint(CHECKPOINT_FILE))
+			fprintf(stderr, "couldn't load %s\n", CHECKPOINT_FILE);
+		ModelerApplication::Instance()->SetControlValue(LOAD_CHECKPOINT, 0);
+	}
+
 	// generate the grammar rules based on our recursion depth setting
 	// (only need to do this if the settings have changed)
 	int r_depth = int (VAL(R_DEPTH) + 0.5);
 	if(r_depth != m_r_depth)
 	{
+		StageTimer timer(m_profiler, PROFILE_GRAMMAR);
 		m_rules = generateGrammar(r_depth); 
 		m_alt_rules = generateAltGrammar(r_depth);
 		m_r_depth = r_depth; // remember setting for the next draw() call
@@ -73,15 +213,64 @@ void SampleModel::draw()
 	int branch_color = int (VAL(B_COLOR) + 0.5);
 	int boid_color = int (VAL(BOID_COLOR) + 0.5);
 
-	// initialize our boids if we haven't already
-	if(m_boids.empty())
-		m_boids = initializeBoids(m_boids, 8);
+	// seed our boids if we haven't already, then spawn or despawn boids to
+	// match the boid count
+	if(!m_boids_seeded)
+	{
+		seedBoids(RANDOM_SEED);
+		m_boids_seeded = true;
+	}
+
+	// a replay reads the file the recording writes, so nothing is recorded
+	// while one is playing
+	bool replaying = (VAL(REPLAY) != 0);
+	bool recording = (VAL(RECORD_TRAJECTORY) != 0) && !replaying;
+	if(recording && !m_recorder.isOpen())
+		m_recorder.open(TRAJECTORY_FILE, false);
+	else if(!recording && m_recorder.isOpen())
+		m_recorder.close();
+	if(replaying && !m_replay.isOpen())
+	{
+		m_replay.open(TRAJECTORY_FILE);
+		m_replay_position = -1.0;
+	}
+	else if(!replaying && m_replay.isOpen())
+		m_replay.close();
 
-	// move & draw the boids
 	glPushMatrix();
 		setColor(boid_color);
-		moveBoids(m_boids);
-		drawBoids(m_boids);
+		if(m_replay.isOpen())
+		{
+			// play the recording instead of moving the boids, which wait where they
+			// are until the replay is turned off. Dragging the position control
+			// jumps to that point of the recording; otherwise the replay plays on
+			// at its speed, and the control follows it.
+			int frames = m_replay.getFrameCount();
+			double position = VAL(REPLAY_POSITION);
+			if(position != m_replay_position)
+				m_replay.seek(position * (frames - 1));
+			else
+				m_replay.advance(VAL(REPLAY_SPEED));
+			m_replay_position = (frames > 1) ? m_replay.getTime() / (frames - 1) : 0.0;
+			ModelerApplication::Instance()->SetControlValue(REPLAY_POSITION, m_replay_position);
+			StageTimer timer(m_profiler, PROFILE_DRAW_BOIDS);
+			drawBoids(m_replay);
+		}
+		else
+		{
+			// move & draw the boids
+			setBoidCount(m_boids, int (VAL(BOID_COUNT) + 0.5), int (VAL(SPECIES_COUNT) + 0.5));
+			SimParams params = getSimParams();
+			params.plant = &m_plant_bvh;
+			params.plant_sdf = m_plant_sdf.empty() ? NULL : &m_plant_sdf;
+			{
+				StageTimer timer(m_profiler, PROFILE_MOVE_BOIDS);
+				moveBoids(m_boids, params);
+			}
+			m_recorder.record(m_boids.current());
+			StageTimer timer(m_profiler, PROFILE_DRAW_BOIDS);
+			drawBoids(m_boids);
+		}
 		setColor(branch_color);
 	glPopMatrix();
 
@@ -93,129 +282,234 @@ void SampleModel::draw()
 		drawBox(10,0.01f,10);
 	glPopMatrix();
 
-	// draw the plant model
-	glPushMatrix();
-	glTranslated(VAL(XPOS), VAL(YPOS), VAL(ZPOS));
-	glRotated(VAL(ROTATE), 0.0, 1.0, 0.0);
-	glRotated(-90, 1.0, 0.0, 0.0);
+	// draw the plant model, following the turtle so the boids know where the
+	// branches are
+	{
+		StageTimer plant_timer(m_profiler, PROFILE_PLANT);
+		m_turtle.reset();
+		turtlePush();
+		turtleTranslate(VAL(XPOS), VAL(YPOS), VAL(ZPOS));
+		turtleRotate(VAL(ROTATE), 0.0, 1.0, 0.0);
+		turtleRotate(-90, 1.0, 0.0, 0.0);
+		drawPlant(m_rules, m_plant_rng, branch_color, leaf_color);
+		turtlePop();
+		// draw the other alternate plant as well, if that's enabled
+		if (VAL(ALT_PLANT))
+		{
+			turtlePush();
+			turtleTranslate(VAL(XPOS)+2.0, VAL(YPOS), VAL(ZPOS)+2.0);
+			turtleScale(0.5);
+			turtleRotate(VAL(ROTATE), 0.0, 1.0, 0.0);
+			turtleRotate(-90, 1.0, 0.0, 0.0);
+			drawPlant(m_alt_rules, m_alt_plant_rng, 4, 5);
+			turtlePop();
+		}
+	}
+
+	// the boids steer around (and perch on) the plant as it was drawn this
+	// frame. The tree, and the distance field if anything uses it, are only
+	// made again when the plant changes: when the grammar or the plant's
+	// controls do, or every frame for a stochastic plant.
+	StageTimer index_timer(m_profiler, PROFILE_PLANT_INDEX);
+	bool plant_changed = (m_turtle.getCapsules() != m_plant_bvh.getCapsules());
+	if(plant_changed)
+		m_plant_bvh.build(m_turtle.getCapsules());
+	if(VAL(PLANT_AVOID_D) == 0 && !VAL(PERCH_ON_PLANT))
+		m_plant_sdf.clear();
+	else if(plant_changed || m_plant_sdf.empty())
+		m_plant_sdf.build(m_plant_bvh, PLANT_SDF_CELL_SIZE, PLANT_SDF_MAX_DISTANCE);
+}
+
+/** @brief SampleModel::saveCheckpoint - Save the whole simulation, so it can be
+ *                                       picked up again exactly where it is
+ *
+ * Along with the boids (see saveBoids()) go the controls, the plant's random
+ * streams, and the plant the boids are steering around this frame.
+ *
+ * @param char path - the file to save to; an existing one is replaced
+ * @return bool - false if the file couldn't be written
+ *
+ **/
+bool SampleModel::saveCheckpoint(const char* path)
+{
+	CheckpointWriter out;
+	out.beginSection("CTRL");
+	int count = NUMCONTROLS;
+	out.write(count);
+	for(int c = 0; c < NUMCONTROLS; c++)
+		out.write(VAL(c));
+	out.endSection();
+
+	saveBoids(out, m_boids);
+
+	out.beginSection("PLNT");
+	out.write(m_plant_rng.getCounter());
+	out.write(m_alt_plant_rng.getCounter());
+	const std::vector<PlantCapsule>& capsules = m_plant_bvh.getCapsules();
+	int num_capsules = int(capsules.size());
+	out.write(num_capsules);
+	out.writeArray(capsules.data(), num_capsules);
+	out.endSection();
+	return out.save(path);
+}
+
+/** @brief SampleModel::loadCheckpoint - Load a simulation saved by saveCheckpoint()
+ *
+ * @param char path
+ * @return bool - false if the file couldn't be read or has no boids in it, in
+ *                which case nothing is changed
+ *
+ **/
+bool SampleModel::loadCheckpoint(const char* path)
+{
+	CheckpointReader in;
+	if(!in.load(path) || !loadBoids(in, m_boids))
+		return false;
+	m_boids_seeded = true;
+
+	int count;
+	if(in.findSection("CTRL") && in.read(count))
+	{
+		for(int c = 0; c < count && c < NUMCONTROLS; c++)
+		{
+			double value;
+			if(!in.read(value))
+				break;
+			ModelerApplication::Instance()->SetControlValue(c, value);
+		}
+	}
+
+	// the plant as it was saved, so the boids steer around the same branches
+	// until it's drawn again
+	unsigned long long plant_counter, alt_plant_counter;
+	int num_capsules;
+	if(in.findSection("PLNT") && in.read(plant_counter) && in.read(alt_plant_counter) &&
+	   in.read(num_capsules) && num_capsules >= 0 &&
+	   size_t(num_capsules) <= in.getBytesLeft() / sizeof(PlantCapsule))
+	{
+		std::vector<PlantCapsule> capsules(num_capsules);
+		if(in.readArray(capsules.data(), num_capsules))
+		{
+			m_plant_rng.setCounter(plant_counter);
+			m_alt_plant_rng.setCounter(alt_plant_counter);
+			m_plant_bvh.build(capsules);
+			m_plant_sdf.clear();
+			if(VAL(PLANT_AVOID_D) != 0 || VAL(PERCH_ON_PLANT))
+				m_plant_sdf.build(m_plant_bvh, PLANT_SDF_CELL_SIZE, PLANT_SDF_MAX_DISTANCE);
+		}
+	}
+	return true;
+}
+
+/** @brief drawPlant - Draw a plant from its grammar string, with the turtle at its base
+ *
+ * @param string rules - the plant's grammar (see generateGrammar())
+ * @param RandomStream rng - where the stochastic branches' choices come from
+ * @param int branch_color - the color setting for the branches
+ * @param int leaf_color - the color setting for the leaves
+ *
+ **/
+void SampleModel::drawPlant(const std::string& rules, RandomStream& rng, int branch_color, int leaf_color)
+{
 	setColor(branch_color);
 
 	// we draw the plant model based on our grammar string
-	for(unsigned int i = 0; i < m_rules.length(); i++)
+	for(unsigned int i = 0; i < rules.length(); i++)
 	{
-		switch(m_rules[i])
+		switch(rules[i])
 		{
 			// draw a branch with a leaf
 			case '0':
-				drawCylinder(VAL(HEIGHT), VAL(B_WIDTH), VAL(B_WIDTH)); 
-				glTranslated(0, 0, VAL(HEIGHT));
+				drawBranch(VAL(HEIGHT), VAL(B_WIDTH)); 
+				turtleTranslate(0, 0, VAL(HEIGHT));
 				setColor(leaf_color);
-				drawSphere(VAL(L_SIZE)); 
+				drawLeaf(VAL(L_SIZE)); 
 				setColor(branch_color);
 				break;
 			// draw a segment of the main 'stem'
 			case '1': 
-				glRotated(VAL(S_ANGLE), 0.0, 1.0, 1.0); 
-				drawCylinder(VAL(HEIGHT), VAL(B_WIDTH), VAL(B_WIDTH)); 
-				glTranslated(0, 0, VAL(HEIGHT));
+				turtleRotate(VAL(S_ANGLE), 0.0, 1.0, 1.0); 
+				drawBranch(VAL(HEIGHT), VAL(B_WIDTH)); 
+				turtleTranslate(0, 0, VAL(HEIGHT));
 				break;
 			// push and rotate 
 			case '[': 
-				glPushMatrix();
-				if(VAL(STOCH) && (rand() % 2) == 1)
+				turtlePush();
+				if(VAL(STOCH) && rng.nextInt(2) == 1)
 				{
-					glRotated(-VAL(B_BEND_ANGLE), 0.0, .33, 0.0);
-					glRotated(-VAL(B_ANGLE), 1.0, 0.0, 1.0); 
+					turtleRotate(-VAL(B_BEND_ANGLE), 0.0, .33, 0.0);
+					turtleRotate(-VAL(B_ANGLE), 1.0, 0.0, 1.0); 
 				}
 				else
 				{
-					glRotated(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-					glRotated(VAL(B_ANGLE), 1.0, 0.0, 1.0); 
+					turtleRotate(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
+					turtleRotate(VAL(B_ANGLE), 1.0, 0.0, 1.0); 
 				}
 				break;
 			// pop and rotate the opposite direction
 			case ']': 
-				glPopMatrix(); 
+				turtlePop(); 
 				if(!VAL(SYMMETRY) && !VAL(STOCH))
-					glRotated(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-				if(VAL(STOCH) && (rand() % 2) == 1)
+					turtleRotate(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
+				if(VAL(STOCH) && rng.nextInt(2) == 1)
 				{
-					glRotated(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-					glRotated(VAL(B_ANGLE), 1.0, 0.0, 1.0); 
+					turtleRotate(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
+					turtleRotate(VAL(B_ANGLE), 1.0, 0.0, 1.0); 
 				}
 				else
 				{
-					glRotated(-VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-					glRotated(-VAL(B_ANGLE), 1.0, 0.0, 1.0); 
+					turtleRotate(-VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
+					turtleRotate(-VAL(B_ANGLE), 1.0, 0.0, 1.0); 
 				}
 				break;
 			default: break;
 		}
 	}
+}
+
+// The plant is drawn through these, so each move is made both in OpenGL and
+// on the turtle (see plantturtle.h)
+
+void SampleModel::turtleTranslate(double x, double y, double z)
+{
+	glTranslated(x, y, z);
+	m_turtle.translate(x, y, z);
+}
+
+void SampleModel::turtleRotate(double angle, double x, double y, double z)
+{
+	glRotated(angle, x, y, z);
+	m_turtle.rotate(angle, x, y, z);
+}
+
+void SampleModel::turtleScale(double s)
+{
+	glScaled(s, s, s);
+	m_turtle.scale(s);
+}
+
+void SampleModel::turtlePush()
+{
+	glPushMatrix();
+	m_turtle.pushMatrix();
+}
+
+void SampleModel::turtlePop()
+{
 	glPopMatrix();
-	// draw the other alternate plant as well, if that's enabled
-	if (VAL(ALT_PLANT))
-	{
-		glPushMatrix();
-		glTranslated(VAL(XPOS)+2.0, VAL(YPOS), VAL(ZPOS)+2.0);
-		glScaled(0.5,0.5,0.5);
-		glRotated(VAL(ROTATE), 0.0, 1.0, 0.0);
-		glRotated(-90, 1.0, 0.0, 0.0);
-		setColor(4);
-		// we draw the plant model based on our grammar string
-		for(unsigned int i = 0; i < m_alt_rules.length(); i++)
-		{
-			switch(m_alt_rules[i])
-			{
-				// draw a branch with a leaf
-				case '0':
-					drawCylinder(VAL(HEIGHT), VAL(B_WIDTH), VAL(B_WIDTH)); 
-					glTranslated(0, 0, VAL(HEIGHT));
-					setColor(5);
-					drawSphere(VAL(L_SIZE)); 
-					setColor(4);
-					break;
-				// draw a segment of the main 'stem'
-				case '1': 
-					glRotated(VAL(S_ANGLE), 0.0, 1.0, 1.0); 
-					drawCylinder(VAL(HEIGHT), VAL(B_WIDTH), VAL(B_WIDTH)); 
-					glTranslated(0, 0, VAL(HEIGHT));
-					break;
-				// push and rotate 
-				case '[': 
-					glPushMatrix();
-					if(VAL(STOCH) && (rand() % 2) == 1)
-					{
-						glRotated(-VAL(B_BEND_ANGLE), 0.0, .33, 0.0);
-						glRotated(-VAL(B_ANGLE), 1.0, 0.0, 1.0); 
-					}
-					else
-					{
-						glRotated(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-						glRotated(VAL(B_ANGLE), 1.0, 0.0, 1.0); 
-					}
-					break;
-				// pop and rotate the opposite direction
-				case ']': 
-					glPopMatrix(); 
-					if(!VAL(SYMMETRY) && !VAL(STOCH))
-						glRotated(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-					if(VAL(STOCH) && (rand() % 2) == 1)
-					{
-						glRotated(VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-						glRotated(VAL(B_ANGLE), 1.0, 0.0, 1.0); 
-					}
-					else
-					{
-						glRotated(-VAL(B_BEND_ANGLE), 0.0, 1.0, 0.0);
-						glRotated(-VAL(B_ANGLE), 1.0, 0.0, 1.0); 
-					}
-					break;
-				default: break;
-			}
-		}
-		glPopMatrix();
-	}
+	m_turtle.popMatrix();
+}
+
+void SampleModel::drawBranch(double height, double width)
+{
+	drawCylinder(height, width, width);
+	m_turtle.addCylinder(height, width);
+}
+
+void SampleModel::drawLeaf(double size)
+{
+	drawSphere(size);
+	m_turtle.addSphere(size);
 }
 
 /** @brief generateGrammar - Generate the grammar for our L-system
@@ -315,6 +609,51 @@ int main()
 	controls[CAN_PERCH] = ModelerControl("Enable Perching", 0, 1, 1, 0);
 	controls[FRAMERATE] = ModelerControl("Low-FPS Mode", 0, 1, 1, 0);
 	controls[ALT_PLANT] = ModelerControl("Generate Alt Plant", 0, 1, 1, 0);
+	// 0 checks every boid, 1 uses the grid, 2 uses the octree (see NeighborSearch)
+	controls[NEIGHBOR_SEARCH] = ModelerControl("Boids Neighbor Search", 0, 2, 1, 1);
+	controls[SIMD_KERNEL] = ModelerControl("Boids SIMD Kernel", 0, 1, 1, 1);
+	controls[THREADS] = ModelerControl("Boids Threads", 1, 16, 1, 1);
+	// 0 flocks by perception distance; otherwise each boid flocks with this many nearest boids
+	controls[NEAREST] = ModelerControl("Boids Nearest Neighbors", 0, 32, 1, 0);
+	// 0 flocks exactly; above 0, distant groups of boids count as one (faster, but rougher)
+	controls[THETA] = ModelerControl("Boids Far-Field Theta", 0, 1, .05f, 0);
+	// 0 searches for neighbors every step; above 0, keeps them for a few steps with this margin
+	controls[SKIN] = ModelerControl("Boids Neighbor List Skin", 0, 2, .05f, 0);
+	// 0 never sorts the boids; otherwise sorts them by position every this many steps
+	controls[SORT_INTERVAL] = ModelerControl("Boids Sort Interval", 0, 100, 1, 0);
+	controls[BOID_COUNT] = ModelerControl("Boid Count", 0, 50000, 1, 8);
+	// the boids are split between this many species, each with its own settings and color
+	controls[SPECIES_COUNT] = ModelerControl("Boid Species", 1, MAX_SPECIES, 1, 1);
+	controls[AVOID_D] = ModelerControl("Boids Species Avoid Distance", .2f, 3.5f, 0.1f, 1.0f);
+	controls[S1_PERCEPTION] = ModelerControl("Species 2 Perception Distance", .5f, 4.0f, .01f, 1.35f);
+	controls[S1_FLOCK_D] = ModelerControl("Species 2 Min Distance", .2f, 3.5f, 0.1f, 0.6f);
+	controls[S1_FLOCK_SPEED] = ModelerControl("Species 2 Velocity", .05f, .35f, .01f, .16f);
+	controls[S2_PERCEPTION] = ModelerControl("Species 3 Perception Distance", .5f, 4.0f, .01f, 1.35f);
+	controls[S2_FLOCK_D] = ModelerControl("Species 3 Min Distance", .2f, 3.5f, 0.1f, 0.6f);
+	controls[S2_FLOCK_SPEED] = ModelerControl("Species 3 Velocity", .05f, .35f, .01f, .16f);
+	controls[S3_PERCEPTION] = ModelerControl("Species 4 Perception Distance", .5f, 4.0f, .01f, 1.35f);
+	controls[S3_FLOCK_D] = ModelerControl("Species 4 Min Distance", .2f, 3.5f, 0.1f, 0.6f);
+	controls[S3_FLOCK_SPEED] = ModelerControl("Species 4 Velocity", .05f, .35f, .01f, .16f);
+	// 0 lets the boids fly through the plant; otherwise they steer away from it within this distance
+	controls[PLANT_AVOID_D] = ModelerControl("Boids Plant Avoid Distance", 0, 2, .05f, 0);
+	// with perching enabled, boids also perch on the branches they fly into
+	controls[PERCH_ON_PLANT] = ModelerControl("Boids Perch On Plant", 0, 1, 1, 0);
+	// while on, every step is recorded to boids.traj (replacing the last recording)
+	controls[RECORD_TRAJECTORY] = ModelerControl("Boids Record Trajectory", 0, 1, 1, 0);
+	// while on, the boids are played back from boids.traj instead of simulated
+	controls[REPLAY] = ModelerControl("Boids Replay", 0, 1, 1, 0);
+	// how far through the recording the replay is, from the start to the end
+	controls[REPLAY_POSITION] = ModelerControl("Boids Replay Position", 0, 1, .001f, 0);
+	// recorded steps played per frame; below 1 is slow motion, and 0 pauses
+	controls[REPLAY_SPEED] = ModelerControl("Boids Replay Speed", 0, 4, .05f, 1);
+	// switch on to save everything to boids.ckpt, or to load it back (each switches
+	// itself off again once it's done)
+	controls[SAVE_CHECKPOINT] = ModelerControl("Save Checkpoint", 0, 1, 1, 0);
+	controls[LOAD_CHECKPOINT] = ModelerControl("Load Checkpoint", 0, 1, 1, 0);
+	// switch on to print how long each part of the last 300 frames took (min, mean,
+	// 95th and 99th percentile), or to dump every timing kept to profile.csv
+	controls[PROFILE_REPORT] = ModelerControl("Print Profile Report", 0, 1, 1, 0);
+	controls[DUMP_PROFILE] = ModelerControl("Dump Profile CSV", 0, 1, 1, 0);
 
 
     ModelerApplication::Instance()->Init(&createSampleModel, controls, NUMCONTROLS);
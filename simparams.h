@@ -0,0 +1,90 @@
+// simparams.h
+
+// The settings the boids simulation runs with. The modeler fills one of
+// these in from its controls once per step (see SampleModel::draw()), so
+// the simulation itself never has to go back to the user interface and
+// can be run without it.
+
+#ifndef SIMPARAMS_H
+#define SIMPARAMS_H
+
+#include <cstddef>
+
+// the most species of boids a flock can have
+const int MAX_SPECIES = 4;
+
+// the settings that can differ between species
+struct SpeciesParams
+{
+	double perception;   // how far away a boid can notice boids of its species
+	double flock_d;      // how close a boid lets boids of its species get
+	double flock_speed;  // the species' top speed
+};
+
+class PlantBVH;
+class PlantSDF;
+
+// how the boids find their neighbors
+enum NeighborSearch
+{
+	SEARCH_ALL = 0,    // check every boid in the flock
+	SEARCH_GRID,       // a uniform grid of perception-sized cells (see boidgrid.h)
+	SEARCH_OCTREE      // an adaptive octree, for tightly packed flocks (see boidoctree.h)
+};
+
+struct SimParams
+{
+	// the defaults match the modeler's initial control values
+	SimParams()
+		: perception(1.35), flock_d(0.6), flock_range(4.5), flock_speed(0.16),
+		  circle_plant(false), can_perch(false), add_wind(false), neighbor_search(SEARCH_GRID), nearest(0), theta(0.0),
+		  skin(0.0), sort_interval(0), num_species(1), avoid_d(1.0), plant(NULL),
+		  plant_sdf(NULL), plant_avoid_d(0.0), perch_on_plant(false), simd(true), threads(1)
+	{
+		for(int s = 0; s < MAX_SPECIES - 1; s++)
+		{
+			species[s].perception = perception;
+			species[s].flock_d = flock_d;
+			species[s].flock_speed = flock_speed;
+		}
+	}
+
+	double perception;   // how far away a boid can notice other boids
+	double flock_d;      // how close a boid lets other boids get
+	double flock_range;  // the boundaries of the flock on each axis
+	double flock_speed;  // the boids' top speed
+	bool circle_plant;   // boids circle the plant
+	bool can_perch;      // boids perch on the ground
+	bool add_wind;       // intermittent gusts of wind
+	int neighbor_search; // how to find neighbors (a NeighborSearch)
+	int nearest;         // if above 0, boids flock with just this many nearest
+	                     // boids, however far away, rather than by perception
+	double theta;        // if above 0, distant groups of boids count as one for
+	                     // cohesion and alignment; larger is faster but rougher
+	double skin;         // if above 0, each boid's neighbors are kept from step to
+	                     // step, with this much margin (see verletlists.h)
+	int sort_interval;   // if above 0, the boids are sorted by position every
+	                     // this many steps, so neighbors sit close in memory
+	int num_species;     // how many species the flock is split between (see
+	                     // setBoidCount()); boids only flock with their own
+	                     // species, and keep away from the others (with more
+	                     // than one, nearest and theta are ignored)
+	SpeciesParams species[MAX_SPECIES - 1];
+	                     // the settings of species 1 and up; species 0 uses
+	                     // perception, flock_d and flock_speed above
+	double avoid_d;      // how close a boid lets boids of other species get
+	const PlantBVH* plant;
+	                     // the plant's branches and leaves, or NULL if there's
+	                     // no plant to steer around (see plantbvh.h)
+	const PlantSDF* plant_sdf;
+	                     // the plant's distance field, or NULL; when there is
+	                     // one it's used instead of the BVH (see plantsdf.h)
+	double plant_avoid_d;// if above 0, boids steer away from the plant when they
+	                     // get this close to it
+	bool perch_on_plant; // boids perch on the plant's branches as well as the
+	                     // ground (with can_perch, and only with plant_sdf)
+	bool simd;           // use the AVX2 flocking kernel, if the processor has it
+	int threads;         // how many threads to move the boids with
+};
+
+#endif
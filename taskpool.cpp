@@ -0,0 +1,187 @@
+#include "taskpool.h"
+#include <algorithm>
+
+using namespace std;
+
+TaskPool::TaskPool()
+	: m_func(NULL), m_generation(0), m_workers_busy(0), m_quit(false)
+{
+	startThreads(1);
+}
+
+TaskPool::~TaskPool()
+{
+	stopThreads();
+}
+
+/** @brief TaskPool::setThreadCount - Change how many threads loops are split across
+ *
+ * @param int num_threads - the number of threads, including the one calling
+ *                          parallelFor()
+ *
+ **/
+void TaskPool::setThreadCount(int num_threads)
+{
+	if(num_threads < 1)
+		num_threads = 1;
+	if(num_threads == getThreadCount())
+		return;
+	stopThreads();
+	startThreads(num_threads);
+}
+
+/** @brief TaskPool::parallelFor - Run a function over the range [0, count) in chunks,
+ *                                 spread across the pool's threads
+ *
+ * The calling thread works on chunks too, and doesn't return until every
+ * chunk is finished.
+ *
+ * @param int count - the size of the range
+ * @param int chunk_size - how many items each call to func gets
+ * @param ChunkFunc func - called once per chunk with its start, end and worker number
+ *
+ **/
+void TaskPool::parallelFor(int count, int chunk_size, const ChunkFunc& func)
+{
+	int num_workers = getThreadCount();
+	if(chunk_size < 1)
+		chunk_size = 1;
+
+	// no one to share with, just run the chunks
+	if(num_workers == 1)
+	{
+		for(int begin = 0; begin < count; begin += chunk_size)
+			func(begin, min(begin + chunk_size, count), 0);
+		return;
+	}
+
+	// deal the chunks out to the workers' queues
+	int chunk_number = 0;
+	for(int begin = 0; begin < count; begin += chunk_size, chunk_number++)
+	{
+		Chunk chunk = {begin, min(begin + chunk_size, count)};
+		Queue* queue = m_queues[chunk_number % num_workers];
+		lock_guard<mutex> queue_lock(queue->lock);
+		queue->chunks.push_back(chunk);
+	}
+
+	// wake everyone up
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_func = &func;
+		m_workers_busy = num_workers - 1;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	runChunks(0);
+
+	// wait for the other workers to finish their last chunks
+	unique_lock<mutex> lock(m_lock);
+	while(m_workers_busy > 0)
+		m_done.wait(lock);
+	m_func = NULL;
+}
+
+/** @brief TaskPool::startThreads - Set up the queues and start the worker threads
+ *
+ **/
+void TaskPool::startThreads(int num_threads)
+{
+	for(int i = 0; i < num_threads; i++)
+		m_queues.push_back(new Queue());
+	// worker 0 is whoever calls parallelFor()
+	for(int i = 1; i < num_threads; i++)
+		m_threads.push_back(thread(&TaskPool::workerLoop, this, i, m_generation));
+}
+
+/** @brief TaskPool::stopThreads - Stop the worker threads and remove their queues
+ *
+ **/
+void TaskPool::stopThreads()
+{
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for(unsigned int i = 0; i < m_threads.size(); i++)
+		m_threads[i].join();
+	m_threads.clear();
+
+	for(unsigned int i = 0; i < m_queues.size(); i++)
+		delete m_queues[i];
+	m_queues.clear();
+	m_quit = false;
+}
+
+/** @brief TaskPool::workerLoop - Wait for loops to work on until the pool shuts down
+ *
+ * @param int worker - this thread's worker number
+ * @param unsigned int generation - the last loop this worker has already seen
+ *
+ **/
+void TaskPool::workerLoop(int worker, unsigned int generation)
+{
+	for(;;)
+	{
+		{
+			unique_lock<mutex> lock(m_lock);
+			while(!m_quit && m_generation == generation)
+				m_wake.wait(lock);
+			if(m_quit)
+				return;
+			generation = m_generation;
+		}
+
+		runChunks(worker);
+
+		lock_guard<mutex> lock(m_lock);
+		if(--m_workers_busy == 0)
+			m_done.notify_all();
+	}
+}
+
+/** @brief TaskPool::runChunks - Keep running chunks until there are none left anywhere
+ *
+ **/
+void TaskPool::runChunks(int worker)
+{
+	Chunk chunk;
+	while(takeChunk(worker, chunk))
+		(*m_func)(chunk.begin, chunk.end, worker);
+}
+
+/** @brief TaskPool::takeChunk - Get the next chunk to work on, from this worker's own
+ *                               queue if it has any left, or else stolen from
+ *                               the back of another worker's queue
+ *
+ * @param int worker - the worker asking
+ * @param Chunk chunk - set to the chunk to run
+ * @return bool - true if a chunk was found, false if every queue is empty
+ *
+ **/
+bool TaskPool::takeChunk(int worker, Chunk& chunk)
+{
+	int num_workers = getThreadCount();
+	for(int i = 0; i < num_workers; i++)
+	{
+		int victim = (worker + i) % num_workers;
+		Queue* queue = m_queues[victim];
+		lock_guard<mutex> queue_lock(queue->lock);
+		if(queue->chunks.empty())
+			continue;
+		if(victim == worker)
+		{
+			chunk = queue->chunks.front();
+			queue->chunks.pop_front();
+		}
+		else
+		{
+			chunk = queue->chunks.back();
+			queue->chunks.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,70 @@
+// taskpool.h
+
+// A small pool of worker threads for splitting loops over the flock.
+// The threads are started once and then wait for work, so handing them
+// a loop every step doesn't pay for creating threads. Each worker has
+// its own queue of chunks; a worker that runs out steals chunks from
+// the others, so uneven chunks (dense parts of the flock) still keep
+// every thread busy.
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class TaskPool
+{
+public:
+	// called with the start and end of a chunk, and the worker running it
+	typedef std::function<void (int begin, int end, int worker)> ChunkFunc;
+
+	TaskPool();
+	~TaskPool();
+
+	void setThreadCount(int num_threads);
+	int getThreadCount() const {return int(m_queues.size());}
+
+	void parallelFor(int count, int chunk_size, const ChunkFunc& func);
+
+private:
+	TaskPool(const TaskPool&);
+	TaskPool& operator=(const TaskPool&);
+
+	struct Chunk
+	{
+		int begin, end;
+	};
+
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<Chunk> chunks;
+	};
+
+	void startThreads(int num_threads);
+	void stopThreads();
+	void workerLoop(int worker, unsigned int generation);
+	void runChunks(int worker);
+	bool takeChunk(int worker, Chunk& chunk);
+
+	std::vector<Queue*> m_queues;
+	std::vector<std::thread> m_threads;
+
+	// the loop currently being run
+	const ChunkFunc* m_func;
+
+	// wakes the workers when there's a new loop (or when it's time to quit)
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	unsigned int m_generation;
+	int m_workers_busy;
+	bool m_quit;
+};
+
+#endif
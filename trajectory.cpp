@@ -0,0 +1,548 @@
+#include "trajectory.h"
+#include "boidswarm.h"
+#include <climits>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char TRAJECTORY_MAGIC[8] = {'B', 'O', 'I', 'D', 'T', 'R', 'A', 'J'};
+
+/** @brief floatToHalf - Round a float to the nearest 16 bit float
+ *
+ * @param float value
+ * @return unsigned short - the half's bits (1 sign, 5 exponent and 10 mantissa);
+ *                          values too big for a half become infinity
+ *
+ **/
+unsigned short floatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int mantissa = bits & 0x7fffff;
+	int float_exponent = int((bits >> 23) & 0xff);
+	// infinity stays infinity, and NaN stays NaN
+	if(float_exponent == 0xff)
+		return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+	int exponent = float_exponent - 127 + 15;
+	if(exponent >= 31)
+		return (unsigned short)(sign | 0x7c00);
+	if(exponent <= 0)
+	{
+		// too small for a normal half; shift the mantissa, leading 1 and all, into a
+		// subnormal one (or all the way out to 0)
+		if(exponent < -10)
+			return (unsigned short)sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int rest = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if(rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return (unsigned short)(sign | half);
+	}
+
+	// round to nearest, ties to even; a mantissa that rounds up past its top
+	// carries into the exponent, which is the right answer (up to infinity)
+	unsigned int half = (unsigned int)(exponent << 10) | (mantissa >> 13);
+	unsigned int rest = mantissa & 0x1fff;
+	if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return (unsigned short)(sign | half);
+}
+
+/** @brief halfToFloat - Widen a 16 bit float to a float, which holds it exactly
+ *
+ * @param unsigned short half - the half's bits
+ * @return float
+ *
+ **/
+float halfToFloat(unsigned short half)
+{
+	unsigned int sign = (unsigned int)(half & 0x8000) << 16;
+	unsigned int exponent = (half >> 10) & 0x1f;
+	unsigned int mantissa = half & 0x3ff;
+	if(exponent == 0)
+	{
+		// zero or subnormal: mantissa * 2^-24
+		float value = float(mantissa) / 16777216.0f;
+		return sign ? -value : value;
+	}
+
+	unsigned int bits;
+	if(exponent == 31)
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/** @brief getComponentBytes - Get how big each position or velocity component is
+ *
+ **/
+static size_t getComponentBytes(bool half)
+{
+	return half ? sizeof(unsigned short) : sizeof(float);
+}
+
+/** @brief getChunkSize - Get how many bytes a step's chunk takes, header and padding
+ *                        included
+ *
+ * @param int boid_count
+ * @param bool half - whether positions and velocities are 16 bit floats
+ *
+ **/
+static size_t getChunkSize(int boid_count, bool half)
+{
+	size_t size = sizeof(TrajectoryChunk) + size_t(boid_count) * (6 * getComponentBytes(half) + sizeof(int) + 1);
+	return (size + 7) & ~size_t(7);
+}
+
+/** @brief isWholeChunk - Check that a chunk is there in full, and its boids fit in it
+ *
+ * @param unsigned char data - the mapped file
+ * @param unsigned long long offset - where the chunk starts
+ * @param unsigned long long end - where the chunk has to end by
+ * @param bool half - whether positions and velocities are 16 bit floats
+ *
+ **/
+static bool isWholeChunk(const unsigned char* data, unsigned long long offset, unsigned long long end, bool half)
+{
+	// compared against what's left rather than added up, so a huge offset
+	// can't wrap around to a small one
+	if(offset % 8 != 0 || offset > end || end - offset < sizeof(TrajectoryChunk))
+		return false;
+	const TrajectoryChunk* chunk = reinterpret_cast<const TrajectoryChunk*>(data + offset);
+	return chunk->tag == TRAJECTORY_CHUNK_TAG && chunk->boid_count >= 0 &&
+	       chunk->size == getChunkSize(chunk->boid_count, half) && chunk->size <= end - offset;
+}
+
+/** @brief makeHeader - Fill in a file header
+ *
+ **/
+static void makeHeader(TrajectoryHeader& header, bool half, unsigned long long index_offset,
+                       unsigned int frame_count)
+{
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+	header.version = TRAJECTORY_VERSION;
+	header.flags = half ? TRAJECTORY_HALF : 0;
+	header.index_offset = index_offset;
+	header.frame_count = frame_count;
+}
+
+TrajectoryRecorder::TrajectoryRecorder()
+	: m_file(NULL), m_half(false), m_frame_count(0), m_quit(false), m_offset(0), m_failed(false)
+{
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+	close();
+}
+
+/** @brief TrajectoryRecorder::open - Start recording to a new file (closing the one
+ *                                    being recorded, if any)
+ *
+ * @param char path - the file to record to; an existing one is replaced
+ * @param bool half - store positions and velocities as 16 bit floats
+ * @return bool - false if the file couldn't be made
+ *
+ **/
+bool TrajectoryRecorder::open(const char* path, bool half)
+{
+	close();
+	m_file = fopen(path, "wb");
+	if(!m_file)
+		return false;
+
+	// the index isn't there yet; close() fills it in
+	TrajectoryHeader header;
+	makeHeader(header, half, 0, 0);
+	if(fwrite(&header, sizeof(header), 1, m_file) != 1)
+	{
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+
+	m_half = half;
+	m_frame_count = 0;
+	m_index.clear();
+	m_offset = sizeof(header);
+	m_failed = false;
+	m_quit = false;
+	m_queue.clear();
+	m_free.clear();
+	for(int b = 0; b < MAX_BUFFERS; b++)
+		m_free.push_back(b);
+	m_writer = thread(&TrajectoryRecorder::writerLoop, this);
+	return true;
+}
+
+/** @brief TrajectoryRecorder::close - Finish writing the steps recorded so far, then the
+ *                                     index, and close the file
+ *
+ * @return bool - false if any of the file couldn't be written
+ *
+ **/
+bool TrajectoryRecorder::close()
+{
+	if(!m_file)
+		return true;
+
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_quit = true;
+	}
+	m_queued.notify_one();
+	m_writer.join();
+
+	// the writer has stopped, so its index is ours now
+	m_frame_count = int(m_index.size());
+	bool ok = !m_failed;
+	if(ok)
+	{
+		TrajectoryHeader header;
+		makeHeader(header, m_half, m_offset, (unsigned int)m_index.size());
+		ok = (m_index.empty() ||
+		      fwrite(m_index.data(), sizeof(m_index[0]), m_index.size(), m_file) == m_index.size()) &&
+		     fseek(m_file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, m_file) == 1;
+	}
+	if(fclose(m_file) != 0)
+		ok = false;
+	m_file = NULL;
+	return ok;
+}
+
+/** @brief TrajectoryRecorder::record - Add a step to the file
+ *
+ * The state is copied before this returns, so it can change straight away;
+ * the copy is written to the file by the writer thread.
+ *
+ * @param BoidState state - the flock as of the step (see BoidSwarm::current())
+ *
+ **/
+void TrajectoryRecorder::record(const BoidState& state)
+{
+	// after a failed write the file ends there, so nothing more is queued
+	if(!m_file || m_failed)
+		return;
+
+	// wait for a buffer if the writer has fallen behind
+	int buffer;
+	{
+		unique_lock<mutex> lock(m_lock);
+		while(m_free.empty())
+			m_written.wait(lock);
+		buffer = m_free.back();
+		m_free.pop_back();
+	}
+
+	int n = state.size();
+	vector<unsigned char>& data = m_buffers[buffer];
+	data.resize(getChunkSize(n, m_half));
+	TrajectoryChunk chunk = {TRAJECTORY_CHUNK_TAG, (unsigned int)data.size(), state.getStep(), n};
+	memcpy(&data[0], &chunk, sizeof(chunk));
+
+	const double* components[6] = {state.posX(), state.posY(), state.posZ(),
+	                               state.velX(), state.velY(), state.velZ()};
+	unsigned char* out = &data[0] + sizeof(chunk);
+	for(int c = 0; c < 6; c++)
+	{
+		const double* values = components[c];
+		if(m_half)
+		{
+			unsigned short* halves = reinterpret_cast<unsigned short*>(out);
+			for(int i = 0; i < n; i++)
+				halves[i] = floatToHalf(float(values[i]));
+		}
+		else
+		{
+			float* floats = reinterpret_cast<float*>(out);
+			for(int i = 0; i < n; i++)
+				floats[i] = float(values[i]);
+		}
+		out += n * getComponentBytes(m_half);
+	}
+	int* slots = reinterpret_cast<int*>(out);
+	for(int i = 0; i < n; i++)
+		slots[i] = state.getSlot(i);
+	out += n * sizeof(int);
+	for(int i = 0; i < n; i++)
+		*out++ = (unsigned char)state.getSpecies(i);
+	// the padding
+	while(out < &data[0] + data.size())
+		*out++ = 0;
+
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_queue.push_back(buffer);
+	}
+	m_queued.notify_one();
+	m_frame_count++;
+}
+
+/** @brief TrajectoryRecorder::writerLoop - Write the queued chunks to the file in order,
+ *                                          until close() is called and none are left
+ *
+ **/
+void TrajectoryRecorder::writerLoop()
+{
+	for(;;)
+	{
+		int buffer;
+		{
+			unique_lock<mutex> lock(m_lock);
+			while(m_queue.empty() && !m_quit)
+				m_queued.wait(lock);
+			if(m_queue.empty())
+				return;
+			// left on the queue while it's written, so record() can't reuse it
+			buffer = m_queue.front();
+		}
+
+		// once a write fails the file is cut short, but the rest still has to be
+		// taken off the queue
+		const vector<unsigned char>& data = m_buffers[buffer];
+		if(!m_failed)
+		{
+			if(fwrite(data.data(), 1, data.size(), m_file) == data.size())
+			{
+				m_index.push_back(m_offset);
+				m_offset += data.size();
+			}
+			else
+				m_failed = true;
+		}
+
+		{
+			lock_guard<mutex> lock(m_lock);
+			m_queue.pop_front();
+			m_free.push_back(buffer);
+		}
+		m_written.notify_one();
+	}
+}
+
+TrajectoryReader::TrajectoryReader()
+	: m_data(NULL), m_size(0),
+#ifdef _WIN32
+	  m_file(NULL), m_mapping(NULL),
+#endif
+	  m_half(false), m_frame_count(0), m_index(NULL)
+{
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+	close();
+}
+
+/** @brief TrajectoryReader::open - Map a recorded file into memory (closing the one
+ *                                  open before, if any)
+ *
+ * @param char path
+ * @return bool - false if the file couldn't be mapped, or isn't a trajectory
+ *
+ **/
+bool TrajectoryReader::open(const char* path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart < LONGLONG(sizeof(TrajectoryHeader)))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<const unsigned char*>(view);
+	m_size = size_t(size.QuadPart);
+#else
+	int fd = ::open(path, O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size < off_t(sizeof(TrajectoryHeader)))
+	{
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file open on its own
+	::close(fd);
+	if(view == MAP_FAILED)
+		return false;
+	m_data = static_cast<const unsigned char*>(view);
+	m_size = size_t(info.st_size);
+#endif
+
+	const TrajectoryHeader* header = reinterpret_cast<const TrajectoryHeader*>(m_data);
+	if(memcmp(header->magic, TRAJECTORY_MAGIC, sizeof(header->magic)) != 0 ||
+	   header->version != TRAJECTORY_VERSION)
+	{
+		close();
+		return false;
+	}
+	m_half = (header->flags & TRAJECTORY_HALF) != 0;
+
+	// a file that was never closed has no index, so look for its chunks instead
+	if(header->index_offset == 0)
+	{
+		findChunks();
+		return true;
+	}
+
+	unsigned long long index_offset = header->index_offset;
+	if(index_offset < sizeof(TrajectoryHeader) || index_offset % sizeof(unsigned long long) != 0 ||
+	   index_offset > m_size || (m_size - index_offset) / sizeof(unsigned long long) < header->frame_count ||
+	   header->frame_count > unsigned(INT_MAX))
+	{
+		close();
+		return false;
+	}
+	m_index = reinterpret_cast<const unsigned long long*>(m_data + index_offset);
+	m_frame_count = int(header->frame_count);
+	// every chunk the index points to is read without further checks
+	for(int f = 0; f < m_frame_count; f++)
+	{
+		if(m_index[f] < sizeof(TrajectoryHeader) || !isWholeChunk(m_data, m_index[f], index_offset, m_half))
+		{
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+/** @brief TrajectoryReader::findChunks - Make an index by following the chunks from the
+ *                                        start of the file, up to the first one that
+ *                                        isn't whole
+ *
+ **/
+void TrajectoryReader::findChunks()
+{
+	m_found_index.clear();
+	unsigned long long offset = sizeof(TrajectoryHeader);
+	while(isWholeChunk(m_data, offset, m_size, m_half))
+	{
+		m_found_index.push_back(offset);
+		offset += reinterpret_cast<const TrajectoryChunk*>(m_data + offset)->size;
+	}
+	m_index = m_found_index.data();
+	m_frame_count = int(m_found_index.size());
+}
+
+/** @brief TrajectoryReader::close - Unmap the file
+ *
+ **/
+void TrajectoryReader::close()
+{
+	if(m_data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		m_mapping = NULL;
+		m_file = NULL;
+#else
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+	}
+	m_data = NULL;
+	m_size = 0;
+	m_index = NULL;
+	m_frame_count = 0;
+	m_found_index.clear();
+}
+
+/** @brief TrajectoryReader::getComponent - Get one component of a boid's position or
+ *                                          velocity
+ *
+ * @param int frame
+ * @param int component - 0 to 2 for the position's x, y and z, 3 to 5 for the velocity's
+ * @param int i - the boid, in the order it was in when the step was recorded
+ *
+ **/
+double TrajectoryReader::getComponent(int frame, int component, int i) const
+{
+	const TrajectoryChunk* chunk = getChunk(frame);
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(chunk + 1);
+	size_t at = size_t(component) * chunk->boid_count + i;
+	if(m_half)
+		return halfToFloat(reinterpret_cast<const unsigned short*>(data)[at]);
+	return reinterpret_cast<const float*>(data)[at];
+}
+
+/** @brief TrajectoryReader::getPosition - Get where a boid was in a recorded step
+ *
+ **/
+Vec3d TrajectoryReader::getPosition(int frame, int i) const
+{
+	return Vec3d(getComponent(frame, 0, i), getComponent(frame, 1, i), getComponent(frame, 2, i));
+}
+
+/** @brief TrajectoryReader::getVelocity - Get a boid's velocity in a recorded step
+ *
+ **/
+Vec3d TrajectoryReader::getVelocity(int frame, int i) const
+{
+	return Vec3d(getComponent(frame, 3, i), getComponent(frame, 4, i), getComponent(frame, 5, i));
+}
+
+/** @brief TrajectoryReader::getSlot - Get a boid's slot in a recorded step, which stays
+ *                                     the same from step to step for as long as the
+ *                                     boid is alive
+ *
+ **/
+int TrajectoryReader::getSlot(int frame, int i) const
+{
+	const TrajectoryChunk* chunk = getChunk(frame);
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(chunk + 1);
+	data += 6 * chunk->boid_count * getComponentBytes(m_half);
+	return reinterpret_cast<const int*>(data)[i];
+}
+
+/** @brief TrajectoryReader::getSpecies - Get a boid's species in a recorded step
+ *
+ **/
+int TrajectoryReader::getSpecies(int frame, int i) const
+{
+	const TrajectoryChunk* chunk = getChunk(frame);
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(chunk + 1);
+	data += chunk->boid_count * (6 * getComponentBytes(m_half) + sizeof(int));
+	return data[i];
+}
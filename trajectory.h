@@ -0,0 +1,166 @@
+// trajectory.h
+
+// Records the flock to a file as the simulation runs, and reads it back.
+//
+// A trajectory file is a header, then one chunk per recorded step, then an
+// index of where each chunk starts:
+//
+//   TrajectoryHeader    magic, version, flags, where the index is
+//   chunk 0             TrajectoryChunk, then the chunk's arrays
+//   chunk 1
+//   ...
+//   index               an unsigned long long file offset per chunk
+//
+// A chunk's arrays are every boid's x position, then every y, then every
+// z, then the same for velocity, each as a float (or, with
+// TRAJECTORY_HALF, as a 16 bit float, which halves the file at about 3
+// significant digits); then each boid's slot (see BoidHandle), so a boid
+// can be followed from one chunk to the next however the swarm reorders
+// it; then each boid's species. Chunks are padded to 8 bytes. Everything
+// is stored in the machine's own byte order (little-endian on the
+// machines this runs on).
+//
+// The recorder copies a step into a buffer and hands it to a thread of its
+// own, so the simulation doesn't wait on the disk; it only blocks if the
+// disk falls a few buffers behind. The index and the header's pointer to
+// it are only written by close(). The reader maps the whole file into
+// memory and finds a frame's boids straight from the index, with nothing
+// read until it's used; a file that was never closed (the program
+// crashed) is still readable, by following the chunks from the start.
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "vec.h"
+#include <cstdio>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class BoidState;
+
+// header flags
+enum
+{
+	TRAJECTORY_HALF = 1  // the chunks' positions and velocities are 16 bit floats
+};
+
+struct TrajectoryHeader
+{
+	char magic[8];                    // "BOIDTRAJ"
+	unsigned int version;             // TRAJECTORY_VERSION
+	unsigned int flags;
+	unsigned long long index_offset;  // where the index starts, 0 until the file is closed
+	unsigned int frame_count;         // how many entries the index has
+	unsigned int reserved;
+};
+
+struct TrajectoryChunk
+{
+	unsigned int tag;                 // TRAJECTORY_CHUNK_TAG
+	unsigned int size;                // the whole chunk in bytes, this included
+	int step;                         // the state's step (see BoidState::getStep())
+	int boid_count;
+};
+
+static const unsigned int TRAJECTORY_VERSION = 1;
+static const unsigned int TRAJECTORY_CHUNK_TAG = 0x4d415246;  // "FRAM"
+
+extern unsigned short floatToHalf(float value);
+extern float halfToFloat(unsigned short half);
+
+class TrajectoryRecorder
+{
+public:
+	TrajectoryRecorder();
+	~TrajectoryRecorder();
+
+	bool open(const char* path, bool half);
+	bool close();
+	bool isOpen() const {return m_file != NULL;}
+	bool isHalf() const {return m_half;}
+
+	void record(const BoidState& state);
+	// the steps recorded so far; once closed, only the ones that made it into
+	// the file (none are taken after a write fails)
+	int getFrameCount() const {return m_frame_count;}
+
+private:
+	TrajectoryRecorder(const TrajectoryRecorder&);
+	TrajectoryRecorder& operator=(const TrajectoryRecorder&);
+
+	// how many steps can be waiting to be written before record() waits
+	static const int MAX_BUFFERS = 8;
+
+	void writerLoop();
+
+	FILE* m_file;
+	bool m_half;
+	int m_frame_count;
+
+	// chunks waiting to be written, and buffers free to fill
+	std::vector<unsigned char> m_buffers[MAX_BUFFERS];
+	std::deque<int> m_queue;
+	std::vector<int> m_free;
+
+	std::thread m_writer;
+	std::mutex m_lock;
+	std::condition_variable m_queued;
+	std::condition_variable m_written;
+	bool m_quit;
+
+	// only touched by the writer until it has finished
+	std::vector<unsigned long long> m_index;
+	unsigned long long m_offset;
+	// set by the writer, and checked by record() to stop taking steps
+	std::atomic<bool> m_failed;
+};
+
+class TrajectoryReader
+{
+public:
+	TrajectoryReader();
+	~TrajectoryReader();
+
+	bool open(const char* path);
+	void close();
+	bool isOpen() const {return m_data != NULL;}
+	bool isHalf() const {return m_half;}
+
+	int getFrameCount() const {return m_frame_count;}
+	int getStep(int frame) const {return getChunk(frame)->step;}
+	int getBoidCount(int frame) const {return getChunk(frame)->boid_count;}
+
+	Vec3d getPosition(int frame, int i) const;
+	Vec3d getVelocity(int frame, int i) const;
+	int getSlot(int frame, int i) const;
+	int getSpecies(int frame, int i) const;
+
+private:
+	TrajectoryReader(const TrajectoryReader&);
+	TrajectoryReader& operator=(const TrajectoryReader&);
+
+	const TrajectoryChunk* getChunk(int frame) const
+		{return reinterpret_cast<const TrajectoryChunk*>(m_data + m_index[frame]);}
+	double getComponent(int frame, int component, int i) const;
+	void findChunks();
+
+	// the mapped file
+	const unsigned char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+
+	bool m_half;
+	int m_frame_count;
+	// the file's index, or the one made by findChunks() if it has none
+	const unsigned long long* m_index;
+	std::vector<unsigned long long> m_found_index;
+};
+
+#endif
@@ -4,7 +4,7 @@
 // Stupid FLTK includes iostream.h, so I can't include the official 
 // STL version of iostream.  Damn it all to bloody hell!  -- ehsu
 
-#if _MSC_VER >= 1300
+#if !defined(_MSC_VER) || _MSC_VER >= 1300
 
 #include <iostream>
 using namespace std;
@@ -99,7 +99,7 @@ public:
 
 	//---[ Friend Methods ]----------------------
 
-#if _MSC_VER >= 1300
+#if !defined(_MSC_VER) || _MSC_VER >= 1300
 
 	template <class U> friend U operator *( const Vec<U>& a, const Vec<U>& b );
 	template <class U> friend Vec<U> operator -( const Vec<U>& v );
@@ -208,7 +208,7 @@ public:
 
 	//---[ Friend Methods ]----------------------
 
-#if _MSC_VER >= 1300
+#if !defined(_MSC_VER) || _MSC_VER >= 1300
 
 	template<class U> friend U operator *( const Vec3<U>& a, const Vec4<U>& b );
 	template<class U> friend U operator *( const Vec4<U>& b, const Vec3<U>& a );
@@ -328,7 +328,7 @@ public:
 	
 	//---[ Friend Methods ]----------------------
 
-#if _MSC_VER >= 1300
+#if !defined(_MSC_VER) || _MSC_VER >= 1300
 
 	template<class U> friend U operator *( const Vec3<U>& a, const Vec4<U>& b );
 	template<class U> friend U operator *( const Vec4<U>& b, const Vec3<U>& a );
@@ -557,7 +557,7 @@ Vec<T> operator-( const Vec<T>& v ) {
 	Vec<T>	result( v.numElements, false );
 
 	for( int i=0;i<v.numElements;i++ )
-		result.n[i] = -n[i];
+		result.n[i] = -v.n[i];
 
 	return result;
 }
@@ -599,7 +599,13 @@ Vec<T> operator^( const Vec<T>& a, const Vec<T>& b ) {
 		throw VectorSizeMismatch();
 #endif
 
-	return *this;
+	// the cross product of the first three elements
+	Vec<T>	result( a.numElements, true );
+	result.n[0] = a.n[1] * b.n[2] - a.n[2] * b.n[1];
+	result.n[1] = a.n[2] * b.n[0] - a.n[0] * b.n[2];
+	result.n[2] = a.n[0] * b.n[1] - a.n[1] * b.n[0];
+
+	return result;
 }
 
 template <class T>
@@ -822,10 +828,10 @@ inline T operator *(const Vec4<T>& a, const Vec4<T>& b) {
 
 template <class T>
 inline Vec4<T> operator *(const Mat4<T>& a, const Vec4<T>& v) {
-	return Vec3<T>( a.n[0]*v.n[0]+a.n[1]*v.n[1]+a.n[2]*v.n[2]+a.n[3]*v.n[3],
+	return Vec4<T>( a.n[0]*v.n[0]+a.n[1]*v.n[1]+a.n[2]*v.n[2]+a.n[3]*v.n[3],
 					a.n[4]*v.n[0]+a.n[5]*v.n[1]+a.n[6]*v.n[2]+a.n[7]*v.n[3],
 					a.n[8]*v.n[0]+a.n[9]*v.n[1]+a.n[10]*v.n[2]+a.n[11]*v.n[3],
-					a.n[12]*v.n[0]+a.n[13]*v.n[1]+a.n[14]*v.n[2]+a.n[15]*v.n[3],);
+					a.n[12]*v.n[0]+a.n[13]*v.n[1]+a.n[14]*v.n[2]+a.n[15]*v.n[3]);
 }
 
 template <class T>
@@ -0,0 +1,121 @@
+#include "verletlists.h"
+#include "boidswarm.h"
+#include "neighborindex.h"
+#include "taskpool.h"
+
+using namespace std;
+
+/** @brief VerletLists::isStale - Check whether the lists have to be made again
+ *
+ * They do if they were never made, if boids have been spawned, despawned or
+ * renumbered (see BoidSwarm::getChangeCount()), if the distances have changed,
+ * or if some boid has moved more than half the skin since they were made (two
+ * boids heading straight at each other could then have closed the whole skin).
+ *
+ * @param BoidSwarm boids - the flock as it is now
+ * @param double perception - how far away a boid can notice other boids
+ * @param double skin - the margin the lists were made with
+ *
+ **/
+bool VerletLists::isStale(const BoidSwarm& boids, double perception, double skin) const
+{
+	if(!m_valid || boids.getChangeCount() != m_changes || boids.size() != int(m_pos_x.size()) ||
+	   perception != m_perception || skin != m_skin)
+		return true;
+
+	const BoidState& state = boids.current();
+	const double* pos_x = state.posX();
+	const double* pos_y = state.posY();
+	const double* pos_z = state.posZ();
+	double max_move2 = (skin * 0.5) * (skin * 0.5);
+	for(int i = 0; i < boids.size(); i++)
+	{
+		double dx = pos_x[i] - m_pos_x[i];
+		double dy = pos_y[i] - m_pos_y[i];
+		double dz = pos_z[i] - m_pos_z[i];
+		if(dx * dx + dy * dy + dz * dz > max_move2)
+			return true;
+	}
+	return false;
+}
+
+/** @brief VerletLists::build - Make every boid's list from where the flock is now
+ *
+ * @param BoidSwarm boids
+ * @param NeighborIndex search - a search built for perception + skin, or NULL to
+ *                               check every boid against every other one
+ * @param double perception - how far away a boid can notice other boids
+ * @param double skin - the margin to add to the lists, so they last a few steps
+ * @param TaskPool pool - the threads to make the lists with
+ * @param int chunk_size - how many boids each thread takes at a time
+ *
+ **/
+void VerletLists::build(const BoidSwarm& boids, const NeighborIndex* search, double perception, double skin,
+                        TaskPool& pool, int chunk_size)
+{
+	int num_boids = boids.size();
+	const BoidState& state = boids.current();
+	const double* pos_x = state.posX();
+	const double* pos_y = state.posY();
+	const double* pos_z = state.posZ();
+	double distance = perception + skin;
+	double distance2 = distance * distance;
+
+	m_pos_x.assign(pos_x, pos_x + num_boids);
+	m_pos_y.assign(pos_y, pos_y + num_boids);
+	m_pos_z.assign(pos_z, pos_z + num_boids);
+	m_perception = perception;
+	m_skin = skin;
+	m_changes = boids.getChangeCount();
+	m_valid = true;
+
+	// each chunk's lists are made on their own, then put together in order
+	int num_chunks = (num_boids + chunk_size - 1) / chunk_size;
+	if(int(m_chunks.size()) < num_chunks)
+		m_chunks.resize(num_chunks);
+	if(int(m_spaces.size()) < pool.getThreadCount())
+		m_spaces.resize(pool.getThreadCount());
+
+	pool.parallelFor(num_boids, chunk_size, [&](int begin, int end, int worker)
+	{
+		ChunkLists& chunk = m_chunks[begin / chunk_size];
+		SearchSpace& space = m_spaces[worker];
+		chunk.neighbors.clear();
+		chunk.counts.clear();
+		for(int i = begin; i < end; i++)
+		{
+			if(search)
+			{
+				search->getNearbyBoids(state.getPosition(i), distance, space.nearby, space.scratch);
+				chunk.neighbors.insert(chunk.neighbors.end(), space.nearby.begin(), space.nearby.end());
+				chunk.counts.push_back(int(space.nearby.size()));
+				continue;
+			}
+			int count = 0;
+			for(int j = 0; j < num_boids; j++)
+			{
+				double dx = pos_x[j] - pos_x[i];
+				double dy = pos_y[j] - pos_y[i];
+				double dz = pos_z[j] - pos_z[i];
+				if(dx * dx + dy * dy + dz * dz <= distance2)
+				{
+					chunk.neighbors.push_back(j);
+					count++;
+				}
+			}
+			chunk.counts.push_back(count);
+		}
+	});
+
+	m_starts.resize(num_boids + 1);
+	m_neighbors.clear();
+	int i = 0;
+	m_starts[0] = 0;
+	for(int c = 0; c < num_chunks; c++)
+	{
+		const ChunkLists& chunk = m_chunks[c];
+		m_neighbors.insert(m_neighbors.end(), chunk.neighbors.begin(), chunk.neighbors.end());
+		for(int k = 0; k < int(chunk.counts.size()); k++, i++)
+			m_starts[i + 1] = m_starts[i] + chunk.counts[k];
+	}
+}
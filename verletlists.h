@@ -0,0 +1,64 @@
+// verletlists.h
+
+// Neighbor lists kept from one step to the next. A boid moves at most the
+// flock's top speed each step, so who is near whom hardly changes between
+// steps. Each boid's list holds every boid within its perception plus a
+// margin (the "skin"), and as long as no boid has moved more than half the
+// skin since the lists were made, every boid that is now within perception
+// is still on the list. The flocking kernels check the actual distance, so
+// the extra boids on a list are just skipped.
+
+#ifndef VERLETLISTS_H
+#define VERLETLISTS_H
+
+#include <vector>
+
+class BoidSwarm;
+class NeighborIndex;
+class TaskPool;
+
+class VerletLists
+{
+public:
+	VerletLists() : m_perception(0.0), m_skin(0.0), m_changes(0), m_valid(false) {}
+
+	bool isStale(const BoidSwarm& boids, double perception, double skin) const;
+	void build(const BoidSwarm& boids, const NeighborIndex* search, double perception, double skin,
+	           TaskPool& pool, int chunk_size);
+	// the lists have to be made again before they're used
+	void invalidate() {m_valid = false;}
+
+	// the boids on boid i's list, in swarm order
+	const int* getNeighbors(int i) const {return m_neighbors.data() + m_starts[i];}
+	int getNeighborCount(int i) const {return m_starts[i + 1] - m_starts[i];}
+
+private:
+	// the lists made from each chunk of boids, before they're put together
+	struct ChunkLists
+	{
+		std::vector<int> neighbors;
+		std::vector<int> counts;
+	};
+
+	// a thread's working space for neighbor searches
+	struct SearchSpace
+	{
+		std::vector<int> nearby;
+		std::vector<int> scratch;
+	};
+
+	// every boid's list, one after another, and where each one starts
+	std::vector<int> m_neighbors;
+	std::vector<int> m_starts;
+	// where the boids were when the lists were made
+	std::vector<double> m_pos_x, m_pos_y, m_pos_z;
+	double m_perception, m_skin;
+	// the swarm's change count when the lists were made
+	unsigned int m_changes;
+	bool m_valid;
+
+	std::vector<ChunkLists> m_chunks;
+	std::vector<SearchSpace> m_spaces;
+};
+
+#endif